@@ -2,6 +2,7 @@
 #include <string>
 #include <iostream>
 #include <variant>
+#include <functional>
 
 // Time to take it further with parse_str
 
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// Heap accounting for tests and benchmarks. Including this header replaces the
+// global allocation functions with ones that count calls and bytes for the
+// calling thread, so include it from exactly one translation unit per binary.
+namespace alloc {
+
+struct Counts {
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+  std::size_t bytes = 0;
+
+  Counts operator-(const Counts& other) const {
+    return { allocations - other.allocations, deallocations - other.deallocations, bytes - other.bytes };
+  }
+};
+
+thread_local Counts current;
+
+// What `f` allocated on this thread, including anything it freed again.
+template <typename F>
+Counts measure(F&& f) {
+  const auto before = current;
+  f();
+  return current - before;
+}
+
+template <typename F>
+std::size_t allocations(F&& f) {
+  return measure(f).allocations;
+}
+
+void* allocate(std::size_t size, std::size_t alignment = 0) {
+  ++current.allocations;
+  current.bytes += size;
+
+  if (size == 0) size = 1;
+  void* p = alignment > alignof(std::max_align_t)
+    ? std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment)
+    : std::malloc(size);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void release(void* p) {
+  if (!p) return;
+  ++current.deallocations;
+  std::free(p);
+}
+
+} // namespace alloc
+
+void* operator new(std::size_t size) { return alloc::allocate(size); }
+void* operator new[](std::size_t size) { return alloc::allocate(size); }
+void* operator new(std::size_t size, std::align_val_t al) { return alloc::allocate(size, std::size_t(al)); }
+void* operator new[](std::size_t size, std::align_val_t al) { return alloc::allocate(size, std::size_t(al)); }
+
+// The library's own nothrow new isn't guaranteed to go through the ones above
+// (std::inplace_merge gets its buffer from it), and what it returns is freed
+// by the delete below, so these have to be replaced too.
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  try { return alloc::allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  try { return alloc::allocate(size); } catch (...) { return nullptr; }
+}
+void* operator new(std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+  try { return alloc::allocate(size, std::size_t(al)); } catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, std::align_val_t al, const std::nothrow_t&) noexcept {
+  try { return alloc::allocate(size, std::size_t(al)); } catch (...) { return nullptr; }
+}
+
+void operator delete(void* p) noexcept { alloc::release(p); }
+void operator delete[](void* p) noexcept { alloc::release(p); }
+void operator delete(void* p, std::size_t) noexcept { alloc::release(p); }
+void operator delete[](void* p, std::size_t) noexcept { alloc::release(p); }
+void operator delete(void* p, std::align_val_t) noexcept { alloc::release(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { alloc::release(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { alloc::release(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { alloc::release(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { alloc::release(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { alloc::release(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { alloc::release(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { alloc::release(p); }
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string_view>
+#include <algorithm>
+#include <vector>
+
+// Tiny timing helpers shared by the *_bench targets. Build with
+// -DCMAKE_BUILD_TYPE=Release, the numbers are meaningless otherwise.
+namespace bench {
+
+using nanoseconds = std::chrono::duration<double, std::nano>;
+
+// Keeps the optimizer from discarding a result we only compute to time it.
+template <typename T>
+void keep(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Runs `f` until `budget` has passed (at least `min_runs` times) and returns
+// the mean time of one run.
+template <typename F>
+nanoseconds time(F&& f, std::chrono::milliseconds budget = std::chrono::milliseconds(200), std::size_t min_runs = 3) {
+  using clock = std::chrono::steady_clock;
+
+  f(); // warm up
+  std::size_t runs = 0;
+  const auto start = clock::now();
+  auto now = start;
+  while (runs < min_runs || now - start < budget) {
+    f();
+    ++runs;
+    now = clock::now();
+  }
+
+  return nanoseconds(now - start) / runs;
+}
+
+void report(std::string_view name, nanoseconds per_run, std::size_t bytes = 0) {
+  std::printf("%-48.*s %12.0f ns", int(name.size()), name.data(), per_run.count());
+  if (bytes) std::printf(" %10.1f MB/s", bytes / per_run.count() * 1e3);
+  std::printf("\n");
+}
+
+// Times `f(i)` for every i < n, one call at a time, and prints the latency
+// percentiles. For when the tail matters, not just the mean.
+template <typename F>
+void latencies(std::string_view name, std::size_t n, F&& f) {
+  using clock = std::chrono::steady_clock;
+
+  std::vector<double> samples;
+  samples.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    const auto start = clock::now();
+    f(i);
+    samples.push_back(nanoseconds(clock::now() - start).count());
+  }
+  std::sort(samples.begin(), samples.end());
+
+  const auto at = [&](double p) { return samples[std::min(samples.size() - 1, std::size_t(p * samples.size()))]; };
+  std::printf("%-48.*s p50 %8.0f  p90 %8.0f  p99 %8.0f  p99.9 %8.0f  max %8.0f ns\n",
+              int(name.size()), name.data(), at(0.5), at(0.9), at(0.99), at(0.999), samples.back());
+}
+
+} // namespace bench
@@ -0,0 +1,54 @@
+#include "../parsec.hpp"
+#include "../bench.hpp"
+#include "./csv.hpp"
+#include "./scan.hpp"
+
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Something like an export: mostly short plain fields, a quoted one with
+// delimiters and doubled quotes in it, and now and then a line break inside
+// quotes.
+std::string document(std::size_t bytes) {
+    std::string doc = "id,name,comment,amount,date\r\n";
+    for (std::size_t i = 0; doc.size() < bytes; ++i) {
+        doc += std::to_string(i) + ",user " + std::to_string(i * 7919 % 1000)
+            + ",\"said \"\"hello, world\"\"" + (i % 16 == 0 ? "\nand more" : "") + "\","
+            + std::to_string(i % 977) + "." + std::to_string(i % 100) + ",2024-01-" + std::to_string(10 + i % 20) + "\r\n";
+    }
+    return doc;
+}
+
+void scanning() {
+    const auto small = document(1 << 16);
+    const auto p = csv::parser();
+    bench::report("parser() 64 KB", bench::time([&] { bench::keep(p(small)); }), small.size());
+
+    csv::table t;
+    bench::report("csv::parse 64 KB", bench::time([&] { bench::keep(csv::parse(small, t)); }), small.size());
+
+    const auto big = document(64 << 20);
+    bench::report("csv::parse 64 MB", bench::time([&] { bench::keep(csv::parse(big, t)); }), big.size());
+    for (const unsigned threads : { 2, 4, 8 }) {
+        bench::report("csv::parse_parallel 64 MB, " + std::to_string(threads) + " threads",
+                      bench::time([&] { bench::keep(csv::parse_parallel(big, t, {}, threads)); }), big.size());
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::pair<std::string_view, std::function<void()>>> benchmarks {
+        { "scan", scanning },
+    };
+
+    for (const auto& [name, run] : benchmarks) {
+        if (argc > 1 && name != argv[1]) continue;
+        std::printf("# %.*s\n", int(name.size()), name.data());
+        run();
+    }
+
+    return 0;
+}
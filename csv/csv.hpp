@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../parsec.hpp"
+#include "./scan.hpp"
+
+namespace csv {
+
+// RFC 4180 as combinators: records separated by line breaks, fields
+// separated by the delimiter, and a field either plain or quoted with
+// doubled quotes inside. Bare LF is accepted as a line break next to CRLF.
+//
+// It matches the whole of a valid file, which makes it the reference for
+// csv::parse; use that one for actually reading files.
+parsec::Parser parser(const dialect d = {}) {
+    using namespace parsec;
+
+    const auto plain = seq::any(match::ch_fn([d](const char c) {
+        return c != d.delimiter && c != d.quote && c != '\r' && c != '\n';
+    }));
+    const auto quoted = seq::andThen({
+        match::ch(d.quote),
+        seq::any(match::oneOf({
+            match::ch_fn([d](const char c) { return c != d.quote; }),
+            match::str({ d.quote, d.quote }),
+        })),
+        match::ch(d.quote),
+    });
+    // plain matches nothing at all too, so it has to come last
+    const auto field = match::oneOf({ quoted, plain });
+
+    const auto record = seq::andThen({
+        field,
+        seq::any(seq::andThen({ match::ch(d.delimiter), field })),
+    });
+    const auto line_break = match::oneOf({ match::str("\r\n"), match::ch('\n') });
+
+    return seq::andThen({
+        record,
+        seq::any(seq::andThen({ line_break, record })),
+    });
+}
+
+} // namespace csv
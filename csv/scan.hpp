@@ -0,0 +1,257 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../parsec_scan.hpp"
+
+// The hand written version of the grammar in csv.hpp: it finds the fields of
+// a whole buffer 64 bytes at a time, and instead of copying them out reports
+// where they are.
+namespace csv {
+
+struct dialect {
+    char delimiter = ',';
+    char quote = '"';
+};
+
+using parsec::scan::status;
+using parsec::scan::prefix_xor;
+
+// Where the fields of a parsed buffer are. Field i is
+// text.substr(offset[i], length[i]); for a quoted field that is the part
+// between the quotes, with any doubled quotes still in it (see unquote()).
+// Record r is made of fields records[r] up to records[r + 1].
+struct table {
+    std::vector<std::size_t> offset;
+    std::vector<std::size_t> length;
+    std::vector<bool> quoted;
+    std::vector<std::size_t> records { 0 };
+
+    std::size_t size() const { return records.size() - 1; }
+    std::size_t fields() const { return offset.size(); }
+
+    std::string_view field(std::string_view text, std::size_t i) const { return text.substr(offset[i], length[i]); }
+
+    void clear() {
+        offset.clear();
+        length.clear();
+        quoted.clear();
+        records.assign(1, 0);
+    }
+};
+
+// The contents of a quoted field, with its doubled quotes made single
+std::string unquote(std::string_view field, const char quote = '"') {
+    std::string out;
+    out.reserve(field.size());
+    for (std::size_t i = 0; i < field.size(); ++i) {
+        out.push_back(field[i]);
+        if (field[i] == quote) ++i;
+    }
+    return out;
+}
+
+namespace scan {
+
+// Bitmasks (bit i for byte i) of the bytes that matter in a 64 byte block
+struct block {
+    std::uint64_t quote = 0;
+    std::uint64_t delimiter = 0;
+    std::uint64_t cr = 0;
+    std::uint64_t lf = 0;
+
+    block(const char* at, const dialect& d) {
+#if defined(__SSE2__)
+        const auto q = _mm_set1_epi8(d.quote);
+        const auto delim = _mm_set1_epi8(d.delimiter);
+        const auto mask = [](const __m128i eq) {
+            return static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(eq)));
+        };
+        for (int i = 0; i < 4; ++i) {
+            const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(at + 16 * i));
+            quote |= mask(_mm_cmpeq_epi8(bytes, q)) << (16 * i);
+            delimiter |= mask(_mm_cmpeq_epi8(bytes, delim)) << (16 * i);
+            cr |= mask(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'))) << (16 * i);
+            lf |= mask(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))) << (16 * i);
+        }
+#else
+        for (int i = 0; i < 64; ++i) {
+            const std::uint64_t bit = std::uint64_t(1) << i;
+            const char c = at[i];
+            quote |= c == d.quote ? bit : 0;
+            delimiter |= c == d.delimiter ? bit : 0;
+            cr |= c == '\r' ? bit : 0;
+            lf |= c == '\n' ? bit : 0;
+        }
+#endif
+    }
+};
+
+// Parses the records in [begin, end) of `text` into `out`. `begin` has to be
+// the start of a record. Quotes are paired up for a whole block at once with
+// prefix_xor (a doubled quote closes and reopens, so it needs no special
+// case), and the rules about where quotes and CRs may appear are checked on
+// the masks too, so bytes inside fields are never looked at one by one.
+status range(std::string_view text, const std::size_t begin, const std::size_t end, const dialect& d, table& out) {
+    std::uint64_t inside = 0;
+    // What the byte before the current block was, as bit 0 of a mask
+    std::uint64_t after_separator = 1;
+    std::uint64_t after_closing = 0;
+    // A closing quote or a CR in the last byte of the previous block, which
+    // the first byte of this one has to agree with
+    std::uint64_t pending_closing = 0;
+    std::uint64_t pending_cr = 0;
+
+    std::size_t field = begin;
+    bool open_record = false;
+
+    const auto fail = [](std::size_t at, const char* what) { return status { at, what }; };
+
+    for (std::size_t at = begin; at < end; at += 64) {
+        char padded[64];
+        const char* bytes = text.data() + at;
+        const auto valid = end - at < 64 ? (std::uint64_t(1) << (end - at)) - 1 : ~std::uint64_t(0);
+        if (end - at < 64) {
+            std::memset(padded, 0, 64);
+            std::memcpy(padded, bytes, end - at);
+            bytes = padded;
+        }
+
+        const block b { bytes, d };
+        const auto quote = b.quote & valid;
+        const auto quoted = prefix_xor(quote) ^ inside;
+        inside = static_cast<std::uint64_t>(static_cast<std::int64_t>(quoted) >> 63);
+
+        const auto opening = quote & quoted;
+        const auto closing = quote & ~quoted;
+        const auto lf = b.lf & valid & ~quoted;
+        const auto separator = (b.delimiter & valid & ~quoted) | lf;
+        const auto cr = b.cr & valid & ~quoted;
+
+        // A field is quoted from its first byte or not at all, a closing quote
+        // ends the field (or is the first half of a doubled quote), and CR
+        // only appears as part of CRLF.
+        const auto allowed_next = separator | cr | opening;
+        std::uint64_t bad = opening & ~(separator << 1 | after_separator | closing << 1 | after_closing);
+        bad |= closing & ~(allowed_next >> 1) & (valid >> 1);
+        bad |= cr & ~(lf >> 1) & (valid >> 1);
+        if (pending_closing & ~allowed_next & 1) return fail(at - 1, "field: Expected a separator after the closing quote");
+        if (pending_cr & ~lf & 1) return fail(at - 1, "record: CR without LF");
+        if (bad) return fail(at + std::countr_zero(bad), "field: Misplaced quote or CR");
+
+        const auto last = std::uint64_t(1) << 63;
+        pending_closing = valid == ~std::uint64_t(0) ? (closing & last) >> 63 : 0;
+        pending_cr = valid == ~std::uint64_t(0) ? (cr & last) >> 63 : 0;
+        after_separator = (separator & last) >> 63;
+        after_closing = (closing & last) >> 63;
+        if (valid != ~std::uint64_t(0)) {
+            const auto top = std::uint64_t(1) << (63 - std::countl_zero(valid));
+            if (cr & top) return fail(end - 1, "record: CR without LF");
+        }
+
+        for (auto bits = separator; bits; bits &= bits - 1) {
+            const auto position = at + std::countr_zero(bits);
+            auto stop = position;
+            if (text[position] == '\n' && stop > field && text[stop - 1] == '\r') --stop;
+
+            const bool is_quoted = stop > field && text[field] == d.quote;
+            out.offset.push_back(field + is_quoted);
+            out.length.push_back(stop - field - 2 * is_quoted);
+            out.quoted.push_back(is_quoted);
+
+            open_record = text[position] != '\n';
+            if (!open_record) out.records.push_back(out.offset.size());
+            field = position + 1;
+        }
+    }
+
+    if (pending_cr) return fail(end - 1, "record: CR without LF");
+    if (inside) return fail(end, "field: Unterminated quoted field");
+    if (field < end || open_record) {
+        const bool is_quoted = field < end && text[field] == d.quote;
+        out.offset.push_back(field + is_quoted);
+        out.length.push_back(end - field - 2 * is_quoted);
+        out.quoted.push_back(is_quoted);
+        out.records.push_back(out.offset.size());
+    }
+
+    return { end };
+}
+
+} // namespace scan
+
+// Finds every field and record of `text`. On failure the offset is where the
+// input stops being RFC 4180 (with `d`'s delimiter and quote).
+status parse(std::string_view text, table& out, const dialect d = {}) {
+    out.clear();
+    return scan::range(text, 0, text.size(), d, out);
+}
+
+// Same result as parse(), from `threads` threads. The text is cut into equal
+// pieces, and a first pass counts the quotes in each piece, which is enough
+// to know whether a piece starts inside a quoted field. Each thread then
+// parses from the first line break outside quotes in its piece up to the
+// next thread's starting point.
+status parse_parallel(std::string_view text, table& out, const dialect d = {},
+                      unsigned threads = std::max(1u, std::thread::hardware_concurrency())) {
+    threads = std::max<std::size_t>(1, std::min<std::size_t>(threads, text.size() / (1 << 16)));
+    if (threads == 1) return parse(text, out, d);
+
+    std::vector<std::size_t> cuts(threads + 1);
+    for (unsigned i = 0; i <= threads; ++i) cuts[i] = text.size() / threads * i;
+    cuts[threads] = text.size();
+
+    const auto each = [threads](auto&& f) {
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < threads; ++i) workers.emplace_back(f, i);
+        for (auto& worker : workers) worker.join();
+    };
+
+    std::vector<std::size_t> quotes(threads);
+    each([&](unsigned i) { quotes[i] = std::count(text.begin() + cuts[i], text.begin() + cuts[i + 1], d.quote); });
+
+    std::vector<std::size_t> starts(threads + 1, text.size());
+    starts[0] = 0;
+    std::size_t parity = 0;
+    for (unsigned i = 1; i < threads; ++i) {
+        parity += quotes[i - 1];
+        bool inside = parity % 2;
+        for (auto at = cuts[i]; at < text.size(); ++at) {
+            if (text[at] == d.quote) inside = !inside;
+            if (text[at] == '\n' && !inside) {
+                starts[i] = at + 1;
+                break;
+            }
+        }
+    }
+    for (unsigned i = threads - 1; i > 0; --i) starts[i] = std::min(starts[i], starts[i + 1]);
+
+    std::vector<table> parts(threads);
+    std::vector<status> results(threads);
+    each([&](unsigned i) { results[i] = scan::range(text, starts[i], starts[i + 1], d, parts[i]); });
+
+    out.clear();
+    for (unsigned i = 0; i < threads; ++i) {
+        const auto base = out.offset.size();
+        out.offset.insert(out.offset.end(), parts[i].offset.begin(), parts[i].offset.end());
+        out.length.insert(out.length.end(), parts[i].length.begin(), parts[i].length.end());
+        out.quoted.insert(out.quoted.end(), parts[i].quoted.begin(), parts[i].quoted.end());
+        for (std::size_t r = 1; r < parts[i].records.size(); ++r) out.records.push_back(base + parts[i].records[r]);
+        if (!results[i]) return results[i];
+    }
+    return { text.size() };
+}
+
+} // namespace csv
@@ -0,0 +1,205 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../parsec.hpp"
+#include "./csv.hpp"
+#include "./scan.hpp"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+using namespace parsec;
+
+using rows = std::vector<std::vector<std::string>>;
+
+// The records of `text` with the quotes taken off, read one byte at a time
+std::optional<rows> reference(const std::string_view text, const csv::dialect d = {}) {
+    rows out;
+    if (text.empty()) return out;
+
+    std::vector<std::string> record;
+    std::string field;
+    std::size_t i = 0;
+    while (true) {
+        if (i < text.size() && text[i] == d.quote) {
+            ++i;
+            while (true) {
+                if (i >= text.size()) return std::nullopt;
+                if (text[i] == d.quote) {
+                    if (i + 1 < text.size() && text[i + 1] == d.quote) {
+                        field += d.quote;
+                        i += 2;
+                        continue;
+                    }
+                    ++i;
+                    break;
+                }
+                field += text[i++];
+            }
+        } else {
+            while (i < text.size() && text[i] != d.delimiter && text[i] != d.quote && text[i] != '\r' && text[i] != '\n') field += text[i++];
+        }
+
+        record.push_back(field);
+        field.clear();
+        if (i == text.size()) {
+            out.push_back(record);
+            return out;
+        }
+        if (text[i] == d.delimiter) {
+            ++i;
+            continue;
+        }
+        if (text[i] == '\r') ++i;
+        if (i >= text.size() || text[i] != '\n') return std::nullopt;
+        ++i;
+        out.push_back(record);
+        record.clear();
+        if (i == text.size()) return out;
+    }
+}
+
+// The same, from a parsed table
+rows read(const std::string_view text, const csv::table& t, const csv::dialect d = {}) {
+    rows out;
+    for (std::size_t r = 0; r < t.size(); ++r) {
+        std::vector<std::string> record;
+        for (auto f = t.records[r]; f < t.records[r + 1]; ++f) {
+            const auto field = t.field(text, f);
+            record.push_back(t.quoted[f] ? csv::unquote(field, d.quote) : std::string(field));
+        }
+        out.push_back(record);
+    }
+    return out;
+}
+
+std::optional<rows> parse(const std::string_view text, const csv::dialect d = {}) {
+    csv::table t;
+    if (!csv::parse(text, t, d)) return std::nullopt;
+    return read(text, t, d);
+}
+
+SCENARIO("Grammar") {
+    const auto p = csv::parser();
+    const auto whole = [&p](const std::string& in) {
+        const auto res = p(in);
+        return std::holds_alternative<Success>(res) && std::get<1>(std::get<Success>(res)).empty();
+    };
+
+    REQUIRE( whole("a,b,c\r\n1,2,3\r\n") );
+    REQUIRE( whole("a,\"b,\"\"c\"\"\r\nd\"\n,") );
+    REQUIRE( whole("") );
+    REQUIRE( !whole("a,b\"c") );
+    REQUIRE( !whole("\"a\"b") );
+    REQUIRE( !whole("\"a") );
+    REQUIRE( !whole("a\rb") );
+}
+
+SCENARIO("Parsing") {
+    GIVEN("Plain and quoted fields") {
+        const std::string text = "name,quote\r\nada,\"says \"\"hi\"\"\"\r\n\"multi\nline\",\r\n,\n";
+        csv::table t;
+        REQUIRE( csv::parse(text, t) );
+
+        THEN("fields are found where they are") {
+            REQUIRE( t.size() == 4 );
+            REQUIRE( t.fields() == 8 );
+            REQUIRE( t.field(text, 3) == "says \"\"hi\"\"" );
+            REQUIRE( t.quoted[3] );
+            REQUIRE( !t.quoted[2] );
+            REQUIRE( t.offset[2] == 12 );
+            REQUIRE( t.length[2] == 3 );
+        }
+
+        THEN("they read the same as the reference") {
+            REQUIRE( read(text, t) == rows {
+                { "name", "quote" }, { "ada", "says \"hi\"" }, { "multi\nline", "" }, { "", "" },
+            } );
+        }
+    }
+
+    GIVEN("A last record without a line break") {
+        REQUIRE( parse("a,b\nc,") == rows { { "a", "b" }, { "c", "" } } );
+        REQUIRE( parse("a") == rows { { "a" } } );
+        REQUIRE( parse("") == rows {} );
+        REQUIRE( parse("\n") == rows { { "" } } );
+    }
+
+    GIVEN("Another dialect") {
+        const csv::dialect tsv { '\t', '\'' };
+        REQUIRE( parse("a\t'b\t''c'\r\n", tsv) == rows { { "a", "b\t'c" } } );
+        REQUIRE( parse("a\t\"b\t", tsv) == rows { { "a", "\"b", "" } } );
+        REQUIRE( !parse("a\t'b", tsv) );
+    }
+
+    GIVEN("Invalid input") {
+        csv::table t;
+        REQUIRE( csv::parse("a,b\"c\n", t).offset == 3 );
+        REQUIRE( csv::parse("a,\"b\"c\n", t).offset == 4 );
+        REQUIRE( csv::parse("a,b\rc\n", t).offset == 3 );
+        REQUIRE( csv::parse("a,b\r", t).offset == 3 );
+        REQUIRE( csv::parse("a,\"b\n", t).offset == 5 );
+    }
+}
+
+SCENARIO("Fast path and grammar agree") {
+    const auto p = csv::parser();
+
+    THEN("on every short string over the interesting characters") {
+        const std::string alphabet = "a,\"\r\n";
+        for (std::size_t n = 0; n < 100000; ++n) {
+            std::string in;
+            for (auto k = n; k; k /= alphabet.size() + 1) {
+                if (k % (alphabet.size() + 1)) in += alphabet[k % (alphabet.size() + 1) - 1];
+            }
+
+            const auto res = p(in);
+            const bool valid = std::holds_alternative<Success>(res) && std::get<1>(std::get<Success>(res)).empty();
+            const auto parsed = parse(in);
+            REQUIRE( parsed.has_value() == valid );
+            REQUIRE( parsed == reference(in) );
+        }
+    }
+
+    THEN("across block boundaries") {
+        const std::string records = "\"x,\r\n\"\"y\"\"\",z\r\n,\"\",\r\nlonger plain field,\"and a quoted one\"\n";
+        for (std::size_t shift = 0; shift < 130; ++shift) {
+            const auto text = std::string(shift, 'p') + "," + records + records;
+            REQUIRE( parse(text) == reference(text) );
+
+            auto broken = text;
+            broken.insert(shift + 5, "\"");
+            REQUIRE( parse(broken) == reference(broken) );
+        }
+    }
+}
+
+SCENARIO("Parallel parsing") {
+    std::string text;
+    for (int i = 0; text.size() < (1 << 20); ++i) {
+        text += std::to_string(i) + ",\"quoted, with a\nline break and \"\"quotes\"\"\",plain\r\n";
+        if (i % 7 == 0) text += "\"" + std::string(i % 300, '\n') + "\",,\n";
+    }
+
+    csv::table expected;
+    REQUIRE( csv::parse(text, expected) );
+
+    for (const unsigned threads : { 2, 3, 8 }) {
+        csv::table t;
+        REQUIRE( csv::parse_parallel(text, t, {}, threads) );
+        REQUIRE( t.offset == expected.offset );
+        REQUIRE( t.length == expected.length );
+        REQUIRE( t.records == expected.records );
+    }
+
+    THEN("errors are reported where parse() reports them") {
+        auto broken = text;
+        broken[broken.find("plain", broken.size() * 2 / 3) + 2] = '"';
+        broken[broken.find("plain", broken.size() / 3) + 2] = '\r';
+        csv::table t;
+        const auto status = csv::parse(broken, t);
+        const auto parallel = csv::parse_parallel(broken, t, {}, 4);
+        REQUIRE( !status );
+        REQUIRE( !parallel );
+        REQUIRE( status.offset == parallel.offset );
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <catch2/catch_test_macros.hpp>
+
+// For tests that compare two ways of parsing the same language: runs them
+// over every document that is one edit away from a known good one, which
+// is where the two tend to disagree.
+namespace edits {
+
+// `holds` has to be true for every document in `corpus` cut short, with one
+// character taken out, or with one of `inserted` put in, at every offset.
+template <typename Predicate>
+void check(const std::vector<std::string>& corpus, const std::string& inserted, Predicate holds) {
+  for (const auto& doc : corpus) {
+    for (std::size_t i = 0; i <= doc.size(); ++i) {
+      std::vector<std::string> edited { doc.substr(0, i), doc.substr(0, i) + doc.substr(std::min(i + 1, doc.size())) };
+      for (const char c : inserted) edited.push_back(doc.substr(0, i) + c + doc.substr(i));
+
+      for (const auto& edit : edited) {
+        INFO( "edit: " << edit );
+        REQUIRE( holds(edit) );
+      }
+    }
+  }
+}
+
+} // namespace edits
@@ -0,0 +1,548 @@
+#include "../parsec.hpp"
+#include "../bench.hpp"
+#include "./json.hpp"
+#include "./sax.hpp"
+#include "./select.hpp"
+#include "./intern.hpp"
+#include "./format.hpp"
+#include "./schema.hpp"
+#include "./lazy.hpp"
+
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A wide record: `fields` members, each a small nested object, so skipping a
+// member costs about as much as selecting it would.
+std::string wide_document(std::size_t fields) {
+    std::string doc = "{";
+    for (std::size_t i = 0; i < fields; ++i) {
+        if (i) doc += ", ";
+        doc += "\"field" + std::to_string(i) + "\": {\"id\": " + std::to_string(i * 7919)
+            + ", \"name\": \"name number " + std::to_string(i) + "\", \"score\": -12.5e-3"
+            + ", \"tags\": [\"alpha\", \"beta\", \"gamma\"], \"nested\": {\"x\": [1, 2, 3, 4]}}";
+    }
+    return doc + "}";
+}
+
+void select_paths() {
+    const auto doc = wide_document(400);
+
+    bench::report("sax::parse (validate all)", bench::time([&] { bench::keep(json::sax::parse(doc)); }), doc.size());
+
+    for (const std::size_t selected : { 400, 100, 20, 4, 1 }) {
+        std::vector<std::string> pointers;
+        for (std::size_t i = 0; i < selected; ++i) {
+            pointers.push_back("/field" + std::to_string(i * (400 / selected)));
+        }
+        const json::pointer_set paths(pointers);
+
+        const auto name = "sax::select " + std::to_string(selected) + "/400 fields";
+        bench::report(name, bench::time([&] { bench::keep(json::sax::select(doc, paths)); }), doc.size());
+    }
+}
+
+std::vector<std::string> number_literals(std::size_t count) {
+    std::vector<std::string> literals;
+    std::uint64_t seed = 42;
+    for (std::size_t i = 0; i < count; ++i) {
+        seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+        const auto r = seed >> 33;
+        switch (i % 4) {
+            case 0: literals.push_back(std::to_string(r % 100000)); break;
+            case 1: literals.push_back("-" + std::to_string(r * 7919)); break;
+            case 2: literals.push_back(std::to_string(r % 1000) + "." + std::to_string(r % 100000000)); break;
+            case 3: literals.push_back("-" + std::to_string(r % 10) + "." + std::to_string(r) + "e-" + std::to_string(r % 30)); break;
+        }
+    }
+    return literals;
+}
+
+// json::number as it was written before scan::number took over
+const auto combinator_digit = parsec::match::ch_fn(json::scan::is_digit);
+const auto combinator_number = parsec::seq::andThen({
+    parsec::optional(parsec::match::ch('-')),
+    parsec::match::oneOf({
+        parsec::seq::andThen({
+            parsec::match::ch_fn([](const char in) { return in >= '1' && in <= '9'; }),
+            parsec::seq::any(combinator_digit)
+        }),
+        parsec::match::ch('0')
+    }),
+    parsec::seq::xImplies({ parsec::match::ch('.'), parsec::seq::some(combinator_digit) }),
+    parsec::seq::xImplies({
+        parsec::match::oneOf({ parsec::match::ch('e'), parsec::match::ch('E') }),
+        parsec::seq::andThen({
+            parsec::optional(parsec::match::oneOf({ parsec::match::ch('-'), parsec::match::ch('+') })),
+            parsec::seq::some(combinator_digit)
+        })
+    })
+});
+
+void numbers() {
+    const auto literals = number_literals(10000);
+    std::size_t bytes = 0;
+    std::string doc = "[";
+    for (const auto& literal : literals) {
+        bytes += literal.size();
+        if (doc.size() > 1) doc += ",";
+        doc += literal;
+    }
+    doc += "]";
+
+    bench::report("combinator json::number + strtod (before)", bench::time([&] {
+        double sum = 0;
+        for (const auto& literal : literals) {
+            const auto res = combinator_number(literal);
+            sum += std::strtod(std::get<0>(std::get<parsec::Success>(res)).c_str(), nullptr);
+        }
+        bench::keep(sum);
+    }), bytes);
+
+    bench::report("json::number + strtod", bench::time([&] {
+        double sum = 0;
+        for (const auto& literal : literals) {
+            const auto res = json::number(literal);
+            sum += std::strtod(std::get<0>(std::get<parsec::Success>(res)).c_str(), nullptr);
+        }
+        bench::keep(sum);
+    }), bytes);
+
+    bench::report("json::number_literal + numeric::real", bench::time([&] {
+        double sum = 0;
+        json::numeric n;
+        for (const auto& literal : literals) {
+            json::number_literal(literal, n);
+            sum += n.real();
+        }
+        bench::keep(sum);
+    }), bytes);
+
+    bench::report("scan::number + numeric::real", bench::time([&] {
+        double sum = 0;
+        json::numeric n;
+        for (const auto& literal : literals) {
+            std::size_t pos = 0;
+            json::scan::number(literal, pos, n);
+            sum += n.real();
+        }
+        bench::keep(sum);
+    }), bytes);
+
+    struct summing : json::sax::handler {
+        double sum = 0;
+        void on_number(const json::numeric& n) { sum += n.real(); }
+    };
+    bench::report("sax::parse array, summing", bench::time([&] {
+        summing h;
+        json::sax::parse(doc, h);
+        bench::keep(h.sum);
+    }), doc.size());
+}
+
+// json::string as it was written before scan::string took over
+const auto combinator_string = parsec::seq::andThen({
+    parsec::match::ch('"'),
+    parsec::match::until(
+        parsec::match::ch('"'),
+        parsec::match::oneOf({
+            parsec::seq::andThen({
+                parsec::match::ch('\\'),
+                parsec::match::oneOf({
+                    parsec::match::ch('"'), parsec::match::ch('\\'), parsec::match::ch('/'),
+                    parsec::match::ch('b'), parsec::match::ch('f'), parsec::match::ch('n'),
+                    parsec::match::ch('r'), parsec::match::ch('t'),
+                    parsec::seq::andThen({
+                        parsec::match::ch('u'),
+                        parsec::match::ch_fn(json::scan::is_hex), parsec::match::ch_fn(json::scan::is_hex),
+                        parsec::match::ch_fn(json::scan::is_hex), parsec::match::ch_fn(json::scan::is_hex),
+                    }),
+                })
+            }),
+            parsec::match::ch_fn([](const char in) { return in != '\\'; })
+        })
+    )
+});
+
+void strings() {
+    std::vector<std::string> literals;
+    std::string doc = "[";
+    for (std::size_t i = 0; i < 2000; ++i) {
+        std::string literal = "\"";
+        for (std::size_t j = 0; j < 8; ++j) literal += "lorem ipsum dolor sit ";
+        if (i % 10 == 0) literal += "caf\xC3\xA9 \xE2\x82\xAC";
+        if (i % 10 == 1) literal += "line\\nbreak \\u00e9 \\uD83D\\uDE00";
+        literal += "\"";
+
+        if (doc.size() > 1) doc += ",";
+        doc += literal;
+        literals.push_back(std::move(literal));
+    }
+    doc += "]";
+
+    bench::report("combinator json::string (before)", bench::time([&] {
+        for (const auto& literal : literals) bench::keep(combinator_string(literal));
+    }), doc.size());
+
+    bench::report("scan::string", bench::time([&] {
+        std::string scratch;
+        std::string_view contents;
+        for (const auto& literal : literals) {
+            std::size_t pos = 0;
+            json::scan::string(literal, pos, contents, scratch);
+            bench::keep(contents);
+        }
+    }), doc.size());
+
+    bench::report("sax::parse string array", bench::time([&] { bench::keep(json::sax::parse(doc)); }), doc.size());
+}
+
+void grammar() {
+    const auto doc = wide_document(40);
+    const auto reference = json::parser(false);
+    const auto optimized = json::parser();
+
+    bench::report("json::parser(false)", bench::time([&] { bench::keep(reference(doc)); }), doc.size());
+    bench::report("json::parser() (optimized)", bench::time([&] { bench::keep(optimized(doc)); }), doc.size());
+
+    // Indented, so that a good part of it is whitespace between tokens
+    std::string indented;
+    std::vector<char> buffer(1 << 16);
+    json::formatter f(buffer, [&indented](const std::string_view out) { indented += out; }, 2);
+    f.feed(doc);
+    f.finish();
+    bench::report("json::parser(false), indented", bench::time([&] { bench::keep(reference(indented)); }), indented.size());
+    bench::report("json::parser() (optimized), indented", bench::time([&] { bench::keep(optimized(indented)); }), indented.size());
+
+    bench::report("json::build_parser(false)", bench::time([] { bench::keep(json::build_parser(false)); }));
+    bench::report("json::build_parser(true)", bench::time([] { bench::keep(json::build_parser(true)); }));
+    bench::report("json::parser(), a copy", bench::time([] { bench::keep(json::parser()); }));
+    for (const auto& [name, p] : { std::pair { "reference", reference }, std::pair { "optimized", optimized } }) {
+        const auto f = parsec::footprint(p);
+        std::printf("  %s: %zu nodes in %zu bytes, %zu as a tree\n", name, f.nodes, f.bytes, f.tree);
+    }
+}
+
+// Records sharing a handful of keys, the case interning is meant for
+void intern() {
+    std::string doc = "[";
+    for (int i = 0; i < 20000; ++i) {
+        if (i) doc += ",";
+        doc += "{\"id\": " + std::to_string(i) + ", \"user_name\": \"u\", \"created_at\": 1, \"is_verified\": 0, \"followers_count\": 2}";
+    }
+    doc += "]";
+
+    struct ids : json::sax::handler {
+        void on_key_id(json::key_id id) { bench::keep(id); }
+    };
+
+    json::key_pool keys;
+    bench::report("sax::parse", bench::time([&] { bench::keep(json::sax::parse(doc)); }), doc.size());
+    bench::report("sax::parse interned keys", bench::time([&] { bench::keep(json::sax::parse(doc, keys, ids {})); }), doc.size());
+
+    const auto stats = keys.statistics();
+    std::printf("%zu keys, hit rate %.6f, %zu of %zu key bytes not stored (%.1f%%)\n",
+                stats.keys, stats.hit_rate(), stats.bytes_saved(), stats.bytes_seen,
+                100.0 * double(stats.bytes_saved()) / double(stats.bytes_seen));
+}
+
+// ~200 byte messages, the kind that arrive by the hundred thousand
+std::vector<std::string> messages(std::size_t count) {
+    std::vector<std::string> out;
+    for (std::size_t i = 0; i < count; ++i) {
+        out.push_back("{\"id\": " + std::to_string(i * 7919) + ", \"user\": \"user" + std::to_string(i % 1000)
+            + "\", \"event\": \"click\", \"at\": 1700000000" + std::to_string(i % 10)
+            + ", \"position\": [" + std::to_string(i % 1280) + ", " + std::to_string(i % 720)
+            + "], \"score\": 0." + std::to_string(i) + ", \"tags\": [\"a\", \"bb\", \"ccc\"], \"note\": \"nothing to see here\"}");
+    }
+    return out;
+}
+
+void batch() {
+    const auto owned = messages(20000);
+    const std::vector<std::string_view> documents(owned.begin(), owned.end());
+    std::size_t bytes = 0;
+    for (const auto document : documents) bytes += document.size();
+    std::printf("%zu documents, %zu bytes each on average\n", documents.size(), bytes / documents.size());
+
+    const auto p = json::parser();
+    parsec::Batch out;
+
+    bench::report("parse_batch (all documents)", bench::time([&] { parsec::parse_batch(documents, p, out); bench::keep(out); }), bytes);
+    bench::report("parser() per document", bench::time([&] { for (const auto d : documents) bench::keep(p(d)); }), bytes);
+
+    std::printf("per document latency:\n");
+    const std::size_t n = documents.size();
+    bench::latencies("json::parser()(doc), new grammar every time", 2000, [&](std::size_t i) { bench::keep(json::parser()(documents[i])); });
+    bench::latencies("p(doc)", n, [&](std::size_t i) { bench::keep(p(documents[i])); });
+    bench::latencies("parse_batch({doc})", n, [&](std::size_t i) {
+        parsec::parse_batch(std::span(&documents[i], 1), p, out);
+        bench::keep(out);
+    });
+}
+
+// Keystrokes in a 10 MB document: each edit changes one digit of an id
+void incremental() {
+    std::string doc = "[";
+    for (const auto& message : messages(60000)) {
+        if (doc.size() > 1) doc += ",\n";
+        doc += message;
+    }
+    doc += "]";
+
+    const auto p = json::parser();
+    bench::report("json::parser() from scratch", bench::time([&] { bench::keep(p(doc)); }, std::chrono::milliseconds(0), 1), doc.size());
+
+    const auto start = std::chrono::steady_clock::now();
+    parsec::Incremental session(p, doc);
+    bench::report("parsec::Incremental first parse", std::chrono::steady_clock::now() - start, doc.size());
+    std::printf("%zu memo entries\n", session.stats().entries);
+
+    std::vector<std::size_t> digits;
+    for (std::size_t at = doc.find("\"id\": "); at != std::string::npos; at = doc.find("\"id\": ", at + 1)) digits.push_back(at + 6);
+
+    std::size_t reused = 0;
+    std::size_t evaluated = 0;
+    const std::size_t edits = 200;
+    bench::latencies("parsec::Incremental::edit (1 character)", edits, [&](std::size_t i) {
+        const auto at = digits[i * 7919 % digits.size()];
+        bench::keep(session.edit(at, 1, std::string(1, char('1' + i % 9))));
+        reused += session.stats().reused;
+        evaluated += session.stats().evaluated;
+    });
+    std::printf("per edit: %zu memo results reused, %zu rules run\n", reused / edits, evaluated / edits);
+}
+
+void format() {
+    std::string doc = "[";
+    for (const auto& message : messages(20000)) {
+        if (doc.size() > 1) doc += ",\n  ";
+        doc += message;
+    }
+    doc += "]";
+
+    std::vector<char> buffer(1 << 16);
+    std::size_t written = 0;
+    const auto sink = [&written](const std::string_view out) { written += out.size(); bench::keep(out); };
+
+    const auto p = json::parser();
+    bench::report("json::parser()", bench::time([&] { bench::keep(p(doc)); }), doc.size());
+    bench::report("sax::parse", bench::time([&] { bench::keep(json::sax::parse(doc)); }), doc.size());
+
+    for (const int indent : { -1, 2 }) {
+        const auto name = indent < 0 ? "formatter minify" : "formatter indent 2";
+        bench::report(name, bench::time([&] {
+            json::formatter f(buffer, sink, indent);
+            f.feed(doc);
+            bench::keep(f.finish());
+        }), doc.size());
+    }
+}
+
+void budget() {
+    const auto doc = wide_document(40);
+    const auto p = json::parser();
+    const parsec::Budget limits { .bytes = 1 << 20, .depth = 512, .steps = 10'000'000 };
+
+    bench::report("json::parser()", bench::time([&] { bench::keep(p(doc)); }), doc.size());
+    bench::report("bounded(json::parser())", bench::time([&] { bench::keep(parsec::bounded(p, doc, limits)); }), doc.size());
+    // No output to build, so what every combinator call costs shows the most
+    bench::report("json::parser().recognize()", bench::time([&] { bench::keep(p.recognize(doc)); }), doc.size());
+    bench::report("json::parser().recognize(), tracking furthest", bench::time([&] {
+        const parsec::Tracked tracked;
+        bench::keep(p.recognize(doc));
+    }), doc.size());
+
+    // Every tenth document is hostile: nested far too deep, or just too long
+    const auto deep = std::string(100000, '[');
+    const auto long_string = "\"" + std::string(8 << 20, 'x') + "\"";
+    bench::latencies("bounded(json::parser()), 1 in 10 hostile", 2000, [&](std::size_t i) {
+        const std::string& in = i % 10 != 9 ? doc : (i % 20 == 9 ? deep : long_string);
+        bench::keep(parsec::bounded(p, in, limits));
+    });
+}
+
+// match::until with literal break points: block comments and the strings
+// above. "opaque" hides the break point so every offset is tried, as before
+// until() looked for the literal itself.
+void until() {
+    using namespace parsec;
+    const auto opaque = [](const Parser& p) -> Parser {
+        return Node { Node::Kind::fn, p.node->run, {}, {}, p.node->recognize };
+    };
+
+    std::string comments;
+    while (comments.size() < (4 << 20)) comments += "/* lorem ipsum * dolor sit amet, consectetur / adipiscing elit */";
+    const auto anything = match::ch_fn([](const char) { return true; });
+    const auto comment = seq::some(seq::andThen({ match::str("/*"), match::until(match::str("*/"), anything) }));
+    const auto comment_opaque = seq::some(seq::andThen({ match::str("/*"), match::until(opaque(match::str("*/")), anything) }));
+
+    bench::report("until(str), block comments", bench::time([&] { bench::keep(comment(comments)); }), comments.size());
+    bench::report("until(str), block comments, recognize", bench::time([&] { bench::keep(comment.recognize(comments)); }), comments.size());
+    bench::report("until(opaque), block comments, recognize", bench::time([&] { bench::keep(comment_opaque.recognize(comments)); }), comments.size());
+
+    std::string strings;
+    while (strings.size() < (4 << 20)) strings += "\"lorem ipsum dolor sit amet \\\"consectetur\\\" adipiscing elit, sed do eiusmod\"";
+    const auto all = seq::some(combinator_string);
+    bench::report("combinator json::string", bench::time([&] { bench::keep(all(strings)); }), strings.size());
+    bench::report("combinator json::string, recognize", bench::time([&] { bench::keep(all.recognize(strings)); }), strings.size());
+}
+
+// Messages that mostly repeat, as heartbeats and config pushes do: 900 of
+// them are one of 16 bodies, the other 100 are all different
+void cache() {
+    std::vector<std::string> messages;
+    std::size_t bytes = 0;
+    for (int i = 0; i < 1000; ++i) {
+        const auto id = i % 10 == 0 ? 1000 + i : i % 16;
+        messages.push_back("{\"type\": \"heartbeat\", \"node\": " + std::to_string(id) + ", \"load\": [0.25, 0.5, 0.75], \"tags\": [\"eu-west\", \"primary\"]}");
+        bytes += messages.back().size();
+    }
+    const auto p = json::parser();
+
+    bench::report("json::parser()", bench::time([&] {
+        for (const auto& message : messages) bench::keep(p(message));
+    }), bytes);
+
+    parsec::Cache cached { p, 1 << 20 };
+    bench::report("Cache { json::parser() }", bench::time([&] {
+        for (const auto& message : messages) bench::keep(cached(message));
+    }), bytes);
+    const auto stats = cached.stats();
+    std::printf("  hits %zu, misses %zu, evictions %zu, %zu entries in %zu bytes\n", stats.hits, stats.misses, stats.evictions, stats.entries, stats.bytes);
+
+    std::string big(1 << 20, 'x');
+    bench::report("hashBytes", bench::time([&] { bench::keep(parsec::hashBytes(big)); }), big.size());
+}
+
+void recognize() {
+    const auto doc = wide_document(400);
+    const auto p = json::parser();
+
+    bench::report("json::parser()", bench::time([&] { bench::keep(p(doc)); }), doc.size());
+    bench::report("json::parser().recognize()", bench::time([&] { bench::keep(p.recognize(doc)); }), doc.size());
+    bench::report("sax::parse (validate all)", bench::time([&] { bench::keep(json::sax::parse(doc)); }), doc.size());
+}
+
+struct order {
+    std::int64_t id = 0;
+    std::string customer;
+    double total = 0;
+    std::uint32_t quantity = 0;
+    std::vector<std::string> items;
+    std::optional<std::string> note;
+};
+
+template <> struct json::schema<order> {
+    static constexpr auto fields = json::fields(
+        json::field("id", &order::id),
+        json::field("customer", &order::customer),
+        json::field("total", &order::total),
+        json::field("quantity", &order::quantity),
+        json::field("items", &order::items),
+        json::field("note", &order::note));
+};
+
+// What filling in orders looks like without a schema: a SAX handler that
+// compares every key it is given
+struct order_handler : json::sax::handler {
+    std::vector<order>& out;
+    std::string key;
+    int depth = 0;
+    bool items = false;
+
+    explicit order_handler(std::vector<order>& out) : out(out) {}
+
+    void on_object_begin() { if (++depth == 2) out.emplace_back(); }
+    void on_object_end() { --depth; }
+    void on_array_begin() { items = depth == 2 && key == "items"; }
+    void on_array_end() { items = false; }
+    void on_key(const std::string_view k) { if (depth == 2) key.assign(k); }
+
+    void on_string(const std::string_view s) {
+        if (depth != 2) return;
+        if (items) out.back().items.emplace_back(s);
+        else if (key == "customer") out.back().customer.assign(s);
+        else if (key == "note") out.back().note.emplace(s);
+    }
+
+    void on_number(const json::numeric& n) {
+        if (depth != 2) return;
+        if (key == "id") out.back().id = n.int64();
+        else if (key == "total") out.back().total = n.real();
+        else if (key == "quantity") out.back().quantity = std::uint32_t(n.int64());
+    }
+};
+
+void schema() {
+    std::string doc = "[";
+    for (std::size_t i = 0; doc.size() < (1 << 20); ++i) {
+        if (i > 0) doc += ", ";
+        doc += "{\"id\": " + std::to_string(100000 + i) + ", \"customer\": \"customer " + std::to_string(i % 977)
+            + "\", \"total\": " + std::to_string(i % 500) + ".95, \"quantity\": " + std::to_string(i % 12 + 1)
+            + ", \"items\": [\"sku-" + std::to_string(i % 31) + "\", \"sku-" + std::to_string(i % 17) + "\"]"
+            + ", \"metadata\": {\"source\": \"web\", \"tags\": [\"a\", \"b\"], \"score\": 0.5}"
+            + (i % 3 == 0 ? ", \"note\": \"leave at the door\"" : "") + "}";
+    }
+    doc += "]";
+
+    const auto p = json::parser();
+    bench::report("json::parser() (match only)", bench::time([&] { bench::keep(p(doc)); }), doc.size());
+
+    std::vector<order> orders;
+    bench::report("sax::parse + key compares", bench::time([&] {
+        orders.clear();
+        order_handler h { orders };
+        bench::keep(json::sax::parse(doc, h));
+    }), doc.size());
+
+    bench::report("json::read<std::vector<order>>", bench::time([&] { bench::keep(json::read(doc, orders)); }), doc.size());
+}
+
+void lazy() {
+    for (const std::size_t size : { 1 << 10, 1 << 16, 1 << 20, 1 << 24 }) {
+        const auto payload = wide_document(size / 260 + 1);
+        const auto doc = "{\"user\": {\"name\": \"ada\", \"id\": 1234}, \"payload\": " + payload + ", \"trailer\": 7}";
+        const auto label = " (" + std::to_string(doc.size() >> 10) + " KB)";
+
+        bench::report("lazy doc[\"user\"][\"id\"]" + label, bench::time([&] {
+            bench::keep(json::lazy { doc }["user"]["id"].int64());
+        }));
+        bench::report("lazy doc[\"trailer\"]" + label, bench::time([&] {
+            bench::keep(json::lazy { doc }["trailer"].int64());
+        }), doc.size());
+        const json::pointer_set paths({ "/user/id" });
+        bench::report("sax::select /user/id" + label, bench::time([&] { bench::keep(json::sax::select(doc, paths)); }));
+        bench::report("sax::parse" + label, bench::time([&] { bench::keep(json::sax::parse(doc)); }), doc.size());
+    }
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::pair<std::string_view, std::function<void()>>> benchmarks {
+        { "select", select_paths },
+        { "numbers", numbers },
+        { "strings", strings },
+        { "grammar", grammar },
+        { "intern", intern },
+        { "batch", batch },
+        { "incremental", incremental },
+        { "format", format },
+        { "budget", budget },
+        { "until", until },
+        { "cache", cache },
+        { "recognize", recognize },
+        { "schema", schema },
+        { "lazy", lazy },
+    };
+
+    for (const auto& [name, run] : benchmarks) {
+        if (argc > 1 && name != argv[1]) continue;
+        std::printf("# %.*s\n", int(name.size()), name.data());
+        run();
+    }
+
+    return 0;
+}
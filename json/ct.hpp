@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string_view>
+
+#include "../parsec_ct.hpp"
+
+// The JSON grammar on the constexpr combinators, for checking JSON literals
+// while compiling:
+//
+//   static_assert(json::ct::valid(R"({"retries": [1, 2, 4]})"));
+//   constexpr auto config = json::ct::literal<R"({"retries": 3})">();
+//
+// It accepts the same documents as json::sax::parse (a single value, no
+// surrounding whitespace), except that bytes above 0x7f inside strings are
+// taken as they are instead of being checked for valid UTF-8.
+namespace json::ct {
+
+namespace pc = parsec::ct;
+
+constexpr auto whitespace = pc::any(pc::oneOf(pc::ch(' '), pc::ch('\n'), pc::ch('\r'), pc::ch('\t')));
+
+constexpr auto digit = pc::ch_fn([](const char c) { return c >= '0' && c <= '9'; });
+constexpr auto digit_pos = pc::ch_fn([](const char c) { return c >= '1' && c <= '9'; });
+constexpr auto hex = pc::ch_fn([](const char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+});
+
+constexpr auto number = pc::andThen(
+    pc::optional(pc::ch('-')),
+    pc::oneOf(pc::andThen(digit_pos, pc::any(digit)), pc::ch('0')),
+    pc::optional(pc::andThen(pc::ch('.'), pc::some(digit))),
+    pc::optional(pc::andThen(
+        pc::oneOf(pc::ch('e'), pc::ch('E')),
+        pc::optional(pc::oneOf(pc::ch('-'), pc::ch('+'))),
+        pc::some(digit)
+    ))
+);
+
+constexpr auto string = pc::andThen(
+    pc::ch('"'),
+    pc::any(pc::oneOf(
+        pc::ch_fn([](const char c) { return c != '"' && c != '\\' && static_cast<unsigned char>(c) >= 0x20; }),
+        pc::andThen(pc::ch('\\'), pc::oneOf(
+            pc::ch_fn([](const char c) { return std::string_view { "\"\\/bfnrt" }.find(c) != std::string_view::npos; }),
+            pc::andThen(pc::ch('u'), hex, hex, hex, hex)
+        ))
+    )),
+    pc::ch('"')
+);
+
+// value, object and array are recursive, so value is a named type whose
+// body comes after the other two.
+struct value_rule {
+    constexpr pc::Match operator()(std::string_view input) const;
+};
+constexpr value_rule value {};
+
+constexpr auto separator = pc::andThen(whitespace, pc::ch(','), whitespace);
+
+constexpr auto member = pc::andThen(string, whitespace, pc::ch(':'), whitespace, value);
+
+constexpr auto object = pc::andThen(
+    pc::ch('{'), whitespace,
+    pc::optional(pc::andThen(member, pc::any(pc::andThen(separator, member)), whitespace)),
+    pc::ch('}')
+);
+
+constexpr auto array = pc::andThen(
+    pc::ch('['), whitespace,
+    pc::optional(pc::andThen(value, pc::any(pc::andThen(separator, value)), whitespace)),
+    pc::ch(']')
+);
+
+constexpr pc::Match value_rule::operator()(const std::string_view input) const {
+    return pc::oneOf(string, number, object, array)(input);
+}
+
+constexpr bool valid(const std::string_view document) {
+    return pc::matches(value, document);
+}
+
+// A JSON literal that does not compile unless it is valid
+template <pc::fixed_string Document>
+constexpr std::string_view literal() {
+    static_assert(valid(Document.view()), "not a valid JSON document");
+    return Document.view();
+}
+
+} // namespace json::ct
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "./scan.hpp"
+
+namespace json {
+
+// Minimal pull generator, until std::generator (C++23) is available to us.
+template <typename T>
+class generator {
+public:
+    struct promise_type {
+        const T* current = nullptr;
+        std::exception_ptr error;
+
+        generator get_return_object() {
+            return generator { std::coroutine_handle<promise_type>::from_promise(*this) };
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(const T& value) noexcept {
+            current = std::addressof(value);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception() { error = std::current_exception(); }
+        template <typename U> void await_transform(U&&) = delete;
+    };
+
+    class iterator {
+    public:
+        explicit iterator(std::coroutine_handle<promise_type> handle = nullptr) : handle(handle) {}
+
+        const T& operator*() const { return *handle.promise().current; }
+        const T* operator->() const { return handle.promise().current; }
+
+        iterator& operator++() {
+            handle.resume();
+            if (handle.done()) {
+                const auto error = handle.promise().error;
+                handle = nullptr;
+                if (error) std::rethrow_exception(error);
+            }
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const { return handle == other.handle; }
+
+    private:
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    generator(generator&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    generator(const generator&) = delete;
+    ~generator() { if (handle) handle.destroy(); }
+
+    iterator begin() {
+        if (!handle) return end();
+        return ++iterator { handle };
+    }
+    iterator end() { return iterator {}; }
+
+private:
+    explicit generator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+enum class event_kind {
+    object_begin,
+    object_end,
+    array_begin,
+    array_end,
+    key,
+    string,
+    number,
+    error,
+};
+
+struct event {
+    event_kind kind;
+    // key/string: the unescaped contents, number: the literal, error: a
+    // description. Views point into the input, or into the generator's own
+    // buffer for unescaped strings, so they are only valid until the next event.
+    std::string_view text;
+    std::size_t offset;
+};
+
+event failed(const std::size_t at, const char* what) {
+    return event { event_kind::error, what, at };
+}
+
+// Walks the same grammar as json::parser() and yields one event per token,
+// resuming only when the consumer asks for the next one. Nested values are
+// tracked on an explicit stack, so stopping early costs nothing and deep
+// documents do not recurse.
+generator<event> events(std::string_view in) {
+    std::vector<char> stack;
+    std::size_t pos = 0;
+    std::string_view text;
+    std::string scratch;
+    numeric number;
+
+    while (true) {
+        // A value is expected at `pos`, whitespace is handled by the caller
+        // (the top level value does not allow leading whitespace).
+        if (pos >= in.size()) { co_yield failed(pos, "value: No more input"); co_return; }
+
+        const std::size_t start = pos;
+        bool opened = false;
+
+        switch (in[pos]) {
+            case '{':
+            case '[': {
+                const char open = in[pos];
+                const char close = open == '{' ? '}' : ']';
+                co_yield event { open == '{' ? event_kind::object_begin : event_kind::array_begin, {}, pos };
+                pos = scan::whitespace(in, pos + 1);
+                if (pos < in.size() && in[pos] == close) {
+                    co_yield event { open == '{' ? event_kind::object_end : event_kind::array_end, {}, pos };
+                    ++pos;
+                    break;
+                }
+                stack.push_back(open);
+                opened = true;
+                break;
+            }
+            case '"':
+                if (!scan::string(in, pos, text, scratch)) { co_yield failed(pos, "string: Unterminated or bad escape"); co_return; }
+                co_yield event { event_kind::string, text, start };
+                break;
+            default:
+                if (!scan::number(in, pos, number)) { co_yield failed(pos, "value: No alternative worked."); co_return; }
+                co_yield event { event_kind::number, number.text, start };
+                break;
+        }
+
+        // Once a value is complete, close every container it completes and
+        // stop at the ',' that continues the innermost one.
+        bool need_key = opened && stack.back() == '{';
+        while (!opened) {
+            if (stack.empty()) co_return;
+
+            pos = scan::whitespace(in, pos);
+            if (pos >= in.size()) { co_yield failed(pos, "container: No more input"); co_return; }
+
+            const char top = stack.back();
+            if (in[pos] == (top == '{' ? '}' : ']')) {
+                co_yield event { top == '{' ? event_kind::object_end : event_kind::array_end, {}, pos };
+                stack.pop_back();
+                ++pos;
+                continue;
+            }
+            if (in[pos] != ',') { co_yield failed(pos, "container: Expected ',' or a closing bracket"); co_return; }
+
+            pos = scan::whitespace(in, pos + 1);
+            need_key = top == '{';
+            break;
+        }
+
+        if (need_key) {
+            const std::size_t key_at = pos;
+            if (!scan::string(in, pos, text, scratch)) { co_yield failed(pos, "object: Expected a key"); co_return; }
+            co_yield event { event_kind::key, text, key_at };
+
+            pos = scan::whitespace(in, pos);
+            if (pos >= in.size() || in[pos] != ':') { co_yield failed(pos, "object: Expected ':'"); co_return; }
+            pos = scan::whitespace(in, pos + 1);
+        }
+    }
+}
+
+} // namespace json
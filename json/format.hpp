@@ -0,0 +1,345 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "./scan.hpp"
+
+namespace json {
+
+// Re-emits a JSON document minified, or pretty printed with `indent` spaces
+// per level, checking it against the grammar on the way through. The input
+// comes in chunks that may be split anywhere (inside a string, a number or an
+// escape) and the output goes into a caller provided buffer, which is handed
+// to `flush` whenever it fills up and at the end. Input is copied out in runs
+// that only break where whitespace is dropped or added, strings and numbers
+// are never decoded. Besides the buffer, the only memory used is a bit per
+// open container.
+//
+// The document is a single value (object, array, string or number), with
+// whitespace allowed around it.
+class formatter {
+public:
+    using flush_fn = std::function<void(std::string_view)>;
+
+    // indent < 0 minifies
+    formatter(std::span<char> buffer, flush_fn flush, int indent = -1)
+        : buffer(buffer), flush(std::move(flush)), indent(indent) {}
+
+    // False once the input is known to be invalid, see status()
+    bool feed(std::string_view chunk) {
+        if (current == state::failed) return false;
+
+        input = chunk;
+        run = 0;
+        std::size_t i = 0;
+        while (i < chunk.size()) {
+            const char c = chunk[i];
+            switch (current) {
+            case state::string: {
+                i = scan::next_special(chunk, i);
+                if (i == chunk.size()) break;
+
+                const auto u = static_cast<unsigned char>(chunk[i]);
+                if (u == '"') {
+                    ++i;
+                    current = key ? state::colon : state::after_value;
+                } else if (u == '\\') {
+                    ++i;
+                    current = state::escape;
+                } else if (u >= 0x80) {
+                    if (!utf8_lead(u)) return fail(i, "string: Invalid UTF-8");
+                    ++i;
+                    current = state::utf8;
+                } else {
+                    return fail(i, "string: Control character");
+                }
+                break;
+            }
+
+            case state::utf8: {
+                const auto u = static_cast<unsigned char>(c);
+                if (u < utf8_low || u > utf8_high) return fail(i, "string: Invalid UTF-8");
+                utf8_low = 0x80;
+                utf8_high = 0xBF;
+                ++i;
+                if (--utf8_needed == 0) current = state::string;
+                break;
+            }
+
+            case state::escape:
+                if (c == 'u') {
+                    hex_needed = 4;
+                    current = state::unicode;
+                } else if (std::string_view { "\"\\/bfnrt" }.find(c) != std::string_view::npos) {
+                    current = state::string;
+                } else {
+                    return fail(i, "string: Bad escape");
+                }
+                ++i;
+                break;
+
+            case state::unicode:
+                if (!scan::is_hex(c)) return fail(i, "string: Bad \\u escape");
+                ++i;
+                if (--hex_needed == 0) current = state::string;
+                break;
+
+            case state::minus:
+            case state::zero:
+            case state::integer:
+            case state::dot:
+            case state::fraction:
+            case state::e:
+            case state::exponent_sign:
+            case state::exponent: {
+                const auto digits_from = i;
+                while (i < chunk.size() && scan::is_digit(chunk[i])) ++i;
+                const bool digits = i > digits_from;
+
+                if (digits) {
+                    switch (current) {
+                    case state::minus: current = chunk[digits_from] == '0' ? state::zero : state::integer; break;
+                    case state::zero: return fail(digits_from, "number: Leading zero");
+                    case state::dot: current = state::fraction; break;
+                    case state::e: case state::exponent_sign: current = state::exponent; break;
+                    default: break;
+                    }
+                    if (current == state::zero && i - digits_from > 1) return fail(digits_from + 1, "number: Leading zero");
+                    continue;
+                }
+
+                if (c == '.' && (current == state::zero || current == state::integer)) {
+                    current = state::dot;
+                    ++i;
+                } else if ((c == 'e' || c == 'E') && (current == state::zero || current == state::integer || current == state::fraction)) {
+                    current = state::e;
+                    ++i;
+                } else if ((c == '+' || c == '-') && current == state::e) {
+                    current = state::exponent_sign;
+                    ++i;
+                } else if (number_complete()) {
+                    // Whatever ends the number is looked at again as punctuation
+                    current = state::after_value;
+                } else {
+                    return fail(i, "number: Expected a digit");
+                }
+                break;
+            }
+
+            default:
+                if (scan::is_whitespace(c)) {
+                    copy(i);
+                    i = scan::whitespace(chunk, i);
+                    run = i;
+                    break;
+                }
+                if (!punctuation(c, i)) return false;
+                ++i;
+                break;
+            }
+        }
+
+        copy(chunk.size());
+        consumed += chunk.size();
+        return true;
+    }
+
+    // The end of the input: checks that the document is complete and writes
+    // out whatever output is still in the buffer.
+    scan::status finish() {
+        if (current != state::failed && number_complete()) current = state::after_value;
+        if (current == state::after_value && open.empty()) current = state::done;
+        if (current != state::done && current != state::failed) fail(0, "document: Unexpected end of input");
+        if (current == state::failed) return { error_at, error };
+
+        if (indent >= 0) put("\n");
+        if (used) flush({ buffer.data(), used });
+        used = 0;
+        return { consumed };
+    }
+
+    scan::status status() const {
+        if (current == state::failed) return { error_at, error };
+        return { consumed };
+    }
+
+private:
+    enum class state : std::uint8_t {
+        value,
+        // Right after '{' or '[', where the container may be closed at once
+        first_key, first_value,
+        key, colon, after_value, done,
+        string, escape, unicode, utf8,
+        minus, zero, integer, dot, fraction, e, exponent_sign, exponent,
+        failed,
+    };
+
+    bool number_complete() const {
+        return current == state::zero || current == state::integer || current == state::fraction || current == state::exponent;
+    }
+
+    bool fail(std::size_t at, const char* what) {
+        current = state::failed;
+        error_at = consumed + at;
+        error = what;
+        return false;
+    }
+
+    bool utf8_lead(unsigned lead) {
+        utf8_low = 0x80;
+        utf8_high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF) {
+            utf8_needed = 1;
+        } else if (lead >= 0xE0 && lead <= 0xEF) {
+            utf8_needed = 2;
+            if (lead == 0xE0) utf8_low = 0xA0;
+            if (lead == 0xED) utf8_high = 0x9F;
+        } else if (lead >= 0xF0 && lead <= 0xF4) {
+            utf8_needed = 3;
+            if (lead == 0xF0) utf8_low = 0x90;
+            if (lead == 0xF4) utf8_high = 0x8F;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Everything outside of strings and numbers
+    bool punctuation(const char c, const std::size_t at) {
+        const bool first = current == state::first_key || current == state::first_value;
+        const char close = open.empty() ? 0 : (open.back() ? '}' : ']');
+
+        if (first && c == close) {
+            close_container();
+            return true;
+        }
+
+        switch (current) {
+        case state::first_key:
+        case state::key:
+            if (c != '"') return fail(at, "object: Expected a key");
+            if (first) newline(at, open.size());
+            key = true;
+            current = state::string;
+            return true;
+
+        case state::colon:
+            if (c != ':') return fail(at, "object: Expected ':'");
+            if (indent >= 0) {
+                copy(at);
+                put(": ");
+                run = at + 1;
+            }
+            current = state::value;
+            return true;
+
+        case state::after_value:
+            if (open.empty()) return fail(at, "document: Expected the end of input");
+            if (c == close) {
+                newline(at, open.size() - 1);
+                close_container();
+                return true;
+            }
+            if (c != ',') return fail(at, open.back() ? "object: Expected ',' or '}'" : "array: Expected ',' or ']'");
+            newline(at + 1, open.size());
+            current = open.back() ? state::key : state::value;
+            return true;
+
+        case state::done:
+            return fail(at, "document: Expected the end of input");
+
+        default:
+            break;
+        }
+
+        // value or first_value
+        if (first) newline(at, open.size());
+        switch (c) {
+        case '{':
+        case '[':
+            open.push_back(c == '{');
+            current = c == '{' ? state::first_key : state::first_value;
+            return true;
+        case '"':
+            key = false;
+            current = state::string;
+            return true;
+        case '-':
+            current = state::minus;
+            return true;
+        default:
+            if (!scan::is_digit(c)) return fail(at, "value: No alternative worked.");
+            current = c == '0' ? state::zero : state::integer;
+            return true;
+        }
+    }
+
+    void close_container() {
+        open.pop_back();
+        current = state::after_value;
+    }
+
+    // Starts a new line, after the input up to `at`
+    void newline(std::size_t at, std::size_t depth) {
+        if (indent < 0) return;
+        static constexpr std::string_view spaces = "                                                                ";
+        copy(at);
+        put("\n");
+        for (auto n = depth * std::size_t(indent); n; ) {
+            const auto step = std::min(n, spaces.size());
+            put(spaces.substr(0, step));
+            n -= step;
+        }
+    }
+
+    // Writes the input from `run` up to `to`
+    void copy(std::size_t to) {
+        put(input.substr(run, to - run));
+        run = to;
+    }
+
+    void put(std::string_view text) {
+        while (!text.empty()) {
+            const auto step = std::min(text.size(), buffer.size() - used);
+            std::memcpy(buffer.data() + used, text.data(), step);
+            used += step;
+            text.remove_prefix(step);
+            if (used == buffer.size()) {
+                flush({ buffer.data(), used });
+                used = 0;
+            }
+        }
+    }
+
+    std::span<char> buffer;
+    flush_fn flush;
+    int indent;
+    std::size_t used = 0;
+
+    // The chunk being fed and the start of what is still to be copied out
+    std::string_view input;
+    std::size_t run = 0;
+
+    state current = state::value;
+    // One per open container, true for objects
+    std::vector<bool> open;
+    // The string being read is an object key
+    bool key = false;
+    int hex_needed = 0;
+    int utf8_needed = 0;
+    unsigned utf8_low = 0x80;
+    unsigned utf8_high = 0xBF;
+
+    std::size_t consumed = 0;
+    std::size_t error_at = 0;
+    const char* error = nullptr;
+};
+
+} // namespace json
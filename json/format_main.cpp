@@ -0,0 +1,81 @@
+#include "./format.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// json_format [--indent N] [--stats] [file]
+//
+// Checks a JSON document and writes it to stdout minified, or pretty printed
+// with N spaces per level. Reads stdin when no file is given. With --stats the
+// sizes and throughput go to stderr, which makes it its own benchmark:
+//
+//   json_format --stats big.json > /dev/null
+//
+// Output is streamed as the input is read, so a document that turns out to be
+// invalid leaves what came before the error on stdout. The exit status is 1
+// for invalid input and 2 when the input can't be read or stdout can't be
+// written.
+int main(int argc, char** argv) {
+    int indent = -1;
+    bool stats = false;
+    const char* path = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--indent") == 0 && i + 1 < argc) {
+            indent = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            stats = true;
+        } else if (argv[i][0] == '-' && argv[i][1] != 0) {
+            std::fprintf(stderr, "usage: %s [--indent N] [--stats] [file]\n", argv[0]);
+            return 2;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    std::FILE* in = path ? std::fopen(path, "rb") : stdin;
+    if (!in) {
+        std::perror(path);
+        return 2;
+    }
+
+    std::size_t written = 0;
+    bool write_failed = false;
+    std::vector<char> output(1 << 16);
+    json::formatter format(output, [&written, &write_failed](const std::string_view out) {
+        if (write_failed) return;
+        write_failed = std::fwrite(out.data(), 1, out.size(), stdout) != out.size();
+        written += out.size();
+    }, indent);
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<char> input(1 << 16);
+    while (const auto n = std::fread(input.data(), 1, input.size(), in)) {
+        if (!format.feed({ input.data(), n }) || write_failed) break;
+    }
+    const bool read_failed = std::ferror(in);
+    if (path) std::fclose(in);
+    const auto status = format.finish();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (read_failed) {
+        std::fprintf(stderr, "%s: read error\n", path ? path : "stdin");
+        return 2;
+    }
+    if (std::fclose(stdout) != 0 || write_failed) {
+        std::perror("stdout");
+        return 2;
+    }
+    if (!status) {
+        std::fprintf(stderr, "%s: error at byte %zu: %s\n", path ? path : "stdin", status.offset, status.error);
+        return 1;
+    }
+    if (stats) {
+        std::fprintf(stderr, "%zu bytes in, %zu bytes out, %.3f s, %.1f MB/s\n",
+                     status.offset, written, elapsed.count(), status.offset / elapsed.count() / 1e6);
+    }
+    return 0;
+}
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "./scan.hpp"
+
+namespace json {
+
+using key_id = std::uint32_t;
+
+// Eight bytes per multiply; good enough to spread object keys over a table.
+// Whole words first, then what is left over and the length, so that a scan
+// can hash a key word by word as it goes (see scan_key).
+constexpr std::uint64_t hash_multiplier = 0x9E3779B97F4A7C15ull;
+
+std::uint64_t hash_word(const std::uint64_t h, const std::uint64_t word) {
+    return std::rotl((h ^ word) * hash_multiplier, 31);
+}
+
+// `tail` holds the last size % 8 bytes, zero padded
+std::uint64_t hash_finish(std::uint64_t h, const std::uint64_t tail, const std::size_t size) {
+    h = hash_word(h ^ size * hash_multiplier, tail);
+    h ^= h >> 32;
+    h *= hash_multiplier;
+    return h ^ (h >> 29);
+}
+
+std::uint64_t hash_key(std::string_view key) {
+    std::uint64_t h = hash_multiplier;
+    std::size_t at = 0;
+    for (; at + 8 <= key.size(); at += 8) h = hash_word(h, scan::load(key.data() + at));
+
+    // The rest as if read with a short memcpy, from a couple of fixed size loads
+    const auto rest = key.size() - at;
+    const auto byte = [&](std::size_t i) { return std::uint64_t(std::uint8_t(key[at + i])) << (8 * i); };
+    std::uint64_t tail = 0;
+    if (rest >= 4) {
+        std::uint32_t low, high;
+        std::memcpy(&low, key.data() + at, 4);
+        std::memcpy(&high, key.data() + at + rest - 4, 4);
+        tail = low | std::uint64_t(high) << (8 * (rest - 4));
+    } else if (rest) {
+        tail = byte(0) | byte(rest / 2) | byte(rest - 1);
+    }
+    return hash_finish(h, tail, key.size());
+}
+
+// scan::string for an object key, which also sets `hash` to hash_key() of
+// it. Plain keys are hashed in the same pass that looks for the closing
+// quote; ones with escapes or non-ASCII bytes are decoded by scan::string
+// and hashed after.
+bool scan_key(std::string_view in, std::size_t& pos, std::string_view& key, std::string& scratch, std::uint64_t& hash) {
+    if constexpr (std::endian::native == std::endian::little) {
+        if (pos < in.size() && in[pos] == '"') {
+            const auto start = pos + 1;
+            std::uint64_t h = hash_multiplier;
+            for (auto at = start; at + 8 <= in.size(); at += 8) {
+                const auto word = scan::load(in.data() + at);
+                const auto hits = scan::specials(word);
+                if (!hits) {
+                    h = hash_word(h, word);
+                    continue;
+                }
+
+                const auto end = at + std::countr_zero(hits) / 8;
+                if (in[end] != '"') break;
+
+                const auto tail = end > at ? word & (~std::uint64_t(0) >> (64 - 8 * (end - at))) : 0;
+                key = in.substr(start, end - start);
+                hash = hash_finish(h, tail, key.size());
+                pos = end + 1;
+                return true;
+            }
+        }
+    }
+
+    if (!scan::string(in, pos, key, scratch)) return false;
+    hash = hash_key(key);
+    return true;
+}
+
+// A table of object keys shared by every document (and thread) that parses
+// with it. Each distinct key is stored once and gets a small id, numbered
+// from 0 in the order keys are first seen. Lookups of known keys take no lock;
+// only inserting a new key does. The capacity is fixed, once it is reached
+// new keys are not interned and intern() returns `none`.
+class key_pool {
+public:
+    static constexpr key_id none = ~key_id(0);
+
+    struct stats {
+        std::size_t lookups = 0;
+        std::size_t hits = 0;
+        std::size_t keys = 0;
+        // Key text passed to intern(), and the part of it that had to be stored
+        std::size_t bytes_seen = 0;
+        std::size_t bytes_stored = 0;
+
+        double hit_rate() const { return lookups ? double(hits) / double(lookups) : 0.0; }
+        std::size_t bytes_saved() const { return bytes_seen - bytes_stored; }
+    };
+
+    explicit key_pool(std::size_t capacity = 4096)
+        : capacity(capacity),
+          mask(std::bit_ceil(capacity * 2) - 1),
+          slots(std::make_unique<std::atomic<const entry*>[]>(mask + 1)),
+          by_id(std::make_unique<std::atomic<const entry*>[]>(capacity)) {}
+
+    // Lookups made through a tally are counted by the caller and handed over
+    // with record() when it is done, instead of bumping shared counters per key.
+    struct tally {
+        std::size_t lookups = 0;
+        std::size_t misses = 0;
+        std::size_t bytes = 0;
+    };
+
+    key_id intern(std::string_view key) {
+        tally t;
+        const auto id = intern(key, hash_key(key), t);
+        record(t);
+        return id;
+    }
+
+    key_id intern(std::string_view key, std::uint64_t hash, tally& t) {
+        ++t.lookups;
+        t.bytes += key.size();
+
+        if (const auto e = find(key, hash)) return e->id;
+
+        // Nothing more goes in once the pool is full, so there is no point in
+        // queueing up on the lock; the last key may have gone in since we looked
+        if (full.load(std::memory_order_acquire)) {
+            if (const auto e = find(key, hash)) return e->id;
+            ++t.misses;
+            return none;
+        }
+
+        const std::lock_guard lock { inserting };
+        // Somebody else may have added it since we looked
+        if (const auto e = find(key, hash)) return e->id;
+        ++t.misses;
+        if (entries.size() == capacity) return none;
+
+        const auto& e = entries.emplace_back(entry { std::string(key), hash, key_id(entries.size()) });
+        bytes_stored.fetch_add(key.size(), std::memory_order_relaxed);
+
+        by_id[e.id].store(&e, std::memory_order_release);
+        auto slot = hash & mask;
+        while (slots[slot].load(std::memory_order_relaxed)) slot = (slot + 1) & mask;
+        slots[slot].store(&e, std::memory_order_release);
+
+        count.store(entries.size(), std::memory_order_release);
+        if (entries.size() == capacity) full.store(true, std::memory_order_release);
+        return e.id;
+    }
+
+    void record(const tally& t) {
+        lookups.fetch_add(t.lookups, std::memory_order_relaxed);
+        misses.fetch_add(t.misses, std::memory_order_relaxed);
+        bytes_seen.fetch_add(t.bytes, std::memory_order_relaxed);
+    }
+
+    // The key text for an id returned by intern(); valid as long as the pool
+    std::string_view name(key_id id) const {
+        return by_id[id].load(std::memory_order_acquire)->name;
+    }
+
+    std::size_t size() const { return count.load(std::memory_order_acquire); }
+
+    stats statistics() const {
+        const auto looked_up = lookups.load(std::memory_order_relaxed);
+        const auto missed = misses.load(std::memory_order_relaxed);
+        return {
+            looked_up,
+            looked_up > missed ? looked_up - missed : 0,
+            size(),
+            bytes_seen.load(std::memory_order_relaxed),
+            bytes_stored.load(std::memory_order_relaxed),
+        };
+    }
+
+private:
+    struct entry {
+        std::string name;
+        std::uint64_t hash;
+        key_id id;
+    };
+
+    const entry* find(std::string_view key, std::uint64_t hash) const {
+        for (auto slot = hash & mask; ; slot = (slot + 1) & mask) {
+            const auto e = slots[slot].load(std::memory_order_acquire);
+            if (!e) return nullptr;
+            if (e->hash == hash && e->name == key) return e;
+        }
+    }
+
+    const std::size_t capacity;
+    const std::uint64_t mask;
+    // Open addressing, at most half full, entries are never removed
+    const std::unique_ptr<std::atomic<const entry*>[]> slots;
+    const std::unique_ptr<std::atomic<const entry*>[]> by_id;
+
+    std::mutex inserting;
+    // Stable addresses, only touched under `inserting`
+    std::deque<entry> entries;
+    std::atomic<std::size_t> count { 0 };
+    std::atomic<bool> full { false };
+
+    std::atomic<std::size_t> lookups { 0 };
+    std::atomic<std::size_t> misses { 0 };
+    std::atomic<std::size_t> bytes_seen { 0 };
+    std::atomic<std::size_t> bytes_stored { 0 };
+};
+
+} // namespace json
@@ -2,182 +2,167 @@
 
 #include <variant>
 
-namespace json {
-
-const auto digit = [](const char in) -> bool {
-    return in >= '0' && in <= '9';
-};
-
-const auto digit_pos = [](const char in) -> bool {
-    return in >= '1' && in <= '9';
-};
-
-
-const auto integer = 
-    parsec::seq::andThen({
-        // sign
-        parsec::optional(parsec::match::ch('-')),
-        // digit, "01" is not a valid number
-        parsec::match::oneOf({
-            parsec::seq::andThen({
-                parsec::match::ch_fn(digit_pos),
-                parsec::seq::any(parsec::match::ch_fn(digit))
-            }),
-            parsec::match::ch('0')
-        }),
-    });
+#include "./scan.hpp"
 
-const auto fraction = 
-    // if a dot is found, we require the fractional part
-    parsec::seq::xImplies({
-        parsec::match::ch('.'),
-        parsec::seq::some(parsec::match::ch_fn(digit))
-    });
+namespace json {
 
-const auto exponent = 
-    parsec::seq::xImplies({
-        parsec::match::oneOf({
-            parsec::match::ch('e'),
-            parsec::match::ch('E')
-        }),
-        parsec::seq::andThen({
-            parsec::optional(
-                parsec::match::oneOf({
-                    parsec::match::ch('-'),
-                    parsec::match::ch('+'),
-                })
-            ),
-            parsec::seq::some(parsec::match::ch_fn(digit))
-        })
-    });
+// Length of the number literal at the start of `input`, 0 if there isn't
+// one. `out` gets its value, converted in the same pass as the grammar is
+// checked, so callers that want the number need no strtod afterwards.
+std::size_t number_literal(const std::string_view input, numeric& out) {
+    std::size_t pos = 0;
+    if (!scan::number(input, pos, out)) {
+        // It gave up where a digit was needed and there wasn't one: first,
+        // or after the sign, the decimal point or the exponent
+        const auto digits = [&input](std::size_t at) {
+            while (at < input.size() && scan::is_digit(input[at])) ++at;
+            return at;
+        };
+        const auto stopped = [&input, &digits]() -> std::size_t {
+            std::size_t at = input.starts_with('-');
+            if (at >= input.size() || !scan::is_digit(input[at])) return at;
+            at = input[at] == '0' ? at + 1 : digits(at);
+            if (at < input.size() && input[at] == '.') {
+                if (digits(at + 1) == at + 1) return at + 1;
+                at = digits(at + 1);
+            }
+            // Only the exponent is left to have gone wrong
+            ++at;
+            if (at < input.size() && (input[at] == '-' || input[at] == '+')) ++at;
+            return at;
+        };
+        const auto at = stopped();
+        parsec::looked(input, at + 1);
+        parsec::failedAt(input.substr(at));
+        return 0;
+    }
+
+    // The character after the literal is where it stopped, as it couldn't
+    // be another digit, a decimal point or an exponent
+    parsec::looked(input, pos + 1);
+    parsec::failedAt(input.substr(pos));
+    return pos;
+}
 
-const auto number = parsec::seq::andThen({
-    integer,
-    fraction,
-    exponent
-});
-
-const auto hex = parsec::match::ch_fn([](const char in) -> bool {
-    return (in >= '0' && in <= '9')
-        || (in >= 'A' && in <= 'F')
-        || (in >= 'a' && in <= 'f');
-});
-
-const auto unicode_str = parsec::seq::andThen({
-    parsec::match::ch('u'),
-    hex,
-    hex,
-    hex,
-    hex
-});
-
-const auto string = parsec::seq::andThen({
-    parsec::match::ch('"'),
-    parsec::match::until(
-        parsec::match::ch('"'),
-        parsec::match::oneOf({
-            parsec::seq::andThen({
-                parsec::match::ch('\\'),
-                parsec::match::oneOf({
-                    parsec::match::ch('"'),
-                    parsec::match::ch('\\'), // reverse solidus
-                    parsec::match::ch('/'), // solidus
-                    parsec::match::ch('b'), // backspace
-                    parsec::match::ch('f'), // formfeed
-                    parsec::match::ch('n'), // formfeed
-                    parsec::match::ch('r'), // formfeed
-                    parsec::match::ch('t'), // formfeed
-                    unicode_str,
-                })
-            }),
-            parsec::match::ch_fn([](const char in) { return in != '\\'; })
-        })
-    )
-});
-
-const auto whitespace = parsec::seq::any(
-    parsec::match::oneOf({
-        parsec::match::ch(' '),
-        parsec::match::ch('\t'),
-        parsec::match::ch('\n'),
-        parsec::match::ch('\r'),
-    })
-);
+// Runs the scan::number kernel rather than a combinator per digit; the match
+// is the literal as written. number_literal(match, n) gets its value.
+const parsec::Parser number = parsec::Node { parsec::Node::Kind::fn, [](const std::string_view input) -> parsec::Result {
+    numeric value;
+    const auto length = number_literal(input, value);
+    if (!length) return parsec::Failure { "number: Expected a valid number" };
+    return parsec::Success { std::string(input.substr(0, length)), input.substr(length) };
+}, {}, {}, [](const std::string_view input) -> parsec::Match {
+    numeric value;
+    if (const auto length = number_literal(input, value)) return length;
+    return std::nullopt;
+} };
+
+// Length of the string literal at the start of `input`, 0 if there isn't one
+std::size_t string_literal(const std::string_view input) {
+    std::size_t pos = 0;
+    std::string_view contents;
+    std::string scratch;
+    if (!scan::string(input, pos, contents, scratch)) {
+        // Where exactly it went wrong is not known, only that it wasn't at
+        // the start, so it depends on everything after
+        parsec::looked(input, input.empty() || input[0] != '"' ? 1 : input.size());
+        parsec::failedAt(input);
+        return 0;
+    }
+
+    parsec::looked(input, pos);
+    return pos;
+}
 
+// Runs the scan::string kernel rather than a combinator per character; the
+// match is the literal as written, quotes and escapes included.
+const parsec::Parser string = parsec::Node { parsec::Node::Kind::fn, [](const std::string_view input) -> parsec::Result {
+    const auto length = string_literal(input);
+    if (!length) return parsec::Failure { "string: Expected a valid string" };
+    return parsec::Success { std::string(input.substr(0, length)), input.substr(length) };
+}, {}, {}, [](const std::string_view input) -> parsec::Match {
+    if (const auto length = string_literal(input)) return length;
+    return std::nullopt;
+} };
+
+// What may go between the tokens of objects and arrays. Their insides are
+// phrases that skip it; the opening bracket isn't part of one, as a value at
+// the top level doesn't start with whitespace.
+const std::string space = " \t\n\r";
+
+// The same as a rule of its own
+const auto whitespace = parsec::seq::any(parsec::match::set(space));
 
 parsec::Parser make_object(const parsec::Parser& value) {
-    return parsec::seq::andThen({
-        parsec::match::ch('{'),
-        parsec::seq::any(
-            parsec::match::oneOf({
-                parsec::match::repeatedly(
-                    parsec::seq::andThen({
-                        parsec::seq::any(whitespace),
-                        string,
-                        parsec::seq::any(whitespace),
-                        parsec::match::ch(':'),
-                        parsec::seq::any(whitespace),
-                        value,
-                        parsec::seq::any(whitespace),
-                    }),
-                    parsec::seq::andThen({
-                        parsec::seq::any(whitespace),
-                        parsec::match::ch(','),
-                        parsec::seq::any(whitespace),
-                    })
-                ),
-                parsec::seq::any(whitespace)
-            })
-        ),
-        parsec::match::ch('}'),
+    using namespace parsec;
+    const auto member = seq::andThen({ lexeme(string), match::ch(':'), lexeme(value) });
+    return seq::andThen({
+        match::ch('{'),
+        phrase(seq::andThen({ seq::any(match::repeatedly(member, match::ch(','))), match::ch('}') }), space),
     });
 }
 
 parsec::Parser make_array(const parsec::Parser& value) {
-    return parsec::seq::andThen({
-        parsec::match::ch('['),
-        parsec::seq::any(
-            parsec::match::oneOf({
-                parsec::match::repeatedly(
-                    parsec::seq::andThen({
-                        parsec::seq::any(whitespace),
-                        value,
-                        parsec::seq::any(whitespace)
-                    }),
-                    parsec::seq::andThen({
-                        parsec::seq::any(whitespace),
-                        parsec::match::ch(','),
-                        parsec::seq::any(whitespace),
-                    })
-                ),
-                parsec::seq::any(whitespace)
-            })
-        ),
-        parsec::match::ch(']')
+    using namespace parsec;
+    return seq::andThen({
+        match::ch('['),
+        phrase(seq::andThen({ seq::any(match::repeatedly(lexeme(value), match::ch(','))), match::ch(']') }), space),
     });
 }
 
 
-parsec::Parser parser() {
+// With `optimized` the object and array rules go through parsec::optimize;
+// the unoptimized grammar is kept around as the reference it is tested against.
+parsec::Parser build_parser(const bool optimized) {
     using namespace parsec;
 
-    // We need a lambda here to keep obj and array in memory
-    // The circular dependencies between obj<>array<>value are tricky
-    return [](const std::string in) {
+    // obj, array and value refer to each other, so they live together and
+    // the rules reach the others through a plain pointer (no shared_ptr
+    // cycle). The grammar is built once per parser() and shared by its copies.
+    struct grammar {
+        Parser value;
         Parser obj;
         Parser array;
+    };
+    const auto g = std::make_shared<grammar>();
+    const auto rules = g.get();
+    // One of the rules, which may not have been built yet
+    const auto rule = [](const Parser* p) -> Parser {
+        return Node { Node::Kind::fn, [p](const std::string_view in) { return (*p)(in); }, {}, {},
+                      [p](const std::string_view in) { return p->recognize(in); } };
+    };
 
-        Parser value = match::oneOf({
-            string,
-            number,
-            [&obj](const auto in) { return obj(in); },
-            [&array](const auto in) { return array(in); }
-        });
-        obj = make_object(value);
-        array = make_array(value);
+    g->value = memo(match::oneOf({
+        string,
+        number,
+        rule(&rules->obj),
+        rule(&rules->array),
+    }));
+    g->obj = make_object(g->value);
+    g->array = make_array(g->value);
+    if (optimized) {
+        // optimize() works on one rule at a time, share() then merges what
+        // the three have in common
+        Sharing share;
+        g->value = share(optimize(g->value));
+        g->obj = share(optimize(g->obj));
+        g->array = share(optimize(g->array));
+    }
+
+    // The rules are listed as children only so that footprint() finds them
+    return Node { Node::Kind::fn, [g](const std::string_view in) { return g->value(in); }, { g->value, g->obj, g->array }, {},
+                  [g](const std::string_view in) { return g->value.recognize(in); } };
+}
 
-        return value(in);
-    };
+// Nodes never change once built, so there is one grammar of each kind and
+// every parser() is a copy of its handle
+parsec::Parser parser(const bool optimized = true) {
+    if (optimized) {
+        static const auto fast = build_parser(true);
+        return fast;
+    }
+    static const auto reference = build_parser(false);
+    return reference;
 }
 
 } // namespace json
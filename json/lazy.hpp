@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "./scan.hpp"
+
+namespace json {
+
+// A value somewhere in a document that hasn't been parsed yet. Looking up a
+// member or an element walks the enclosing container from its start and
+// passes over everything in the way with scan::skip_value, which only
+// balances brackets and quotes (64 bytes at a time for containers), so
+//
+//   json::lazy doc { body };
+//   const auto id = doc["user"]["id"].int64();
+//
+// costs about as much as the bytes in front of "user" and "id", whatever
+// comes after them. Only the values that are read are checked against the
+// grammar and converted; skipped ones are never unescaped or validated (run
+// sax::parse first where that matters).
+//
+// A lookup that finds nothing gives an empty value, and so does every lookup
+// on an empty value, so chains need no checks in between. error() tells a
+// member that isn't there apart from a document that stops making sense.
+//
+// Unlike sax::parse, the document may start with whitespace, which is
+// skipped; offsets still count from the start of `text`.
+class lazy {
+public:
+    enum class kind { none, object, array, string, number };
+
+    explicit lazy(const std::string_view text) : lazy(text, scan::whitespace(text, 0)) {
+        if (pos >= in.size()) *this = failed(pos, "value: No more input");
+    }
+
+    explicit operator bool() const { return pos != npos; }
+
+    // Set when the lookup that made this value ran into invalid input
+    const char* error() const { return problem; }
+    // Where the value starts, or where the problem was
+    std::size_t offset() const { return at_error; }
+
+    kind type() const {
+        if (!*this) return kind::none;
+        switch (in[pos]) {
+            case '{': return kind::object;
+            case '[': return kind::array;
+            case '"': return kind::string;
+            default: return kind::number;
+        }
+    }
+
+    // The first member called `key`, compared after unescaping
+    lazy operator[](const std::string_view key) const {
+        if (!*this) return *this;
+        if (type() != kind::object) return missing();
+
+        std::size_t at = scan::whitespace(in, pos + 1);
+        if (at < in.size() && in[at] == '}') return missing();
+
+        while (true) {
+            if (at >= in.size() || in[at] != '"') return failed(at, "object: Expected a key");
+
+            // Most keys have no escapes and are compared where they are
+            bool found;
+            const auto end = scan::next_quote_or_escape(in, at + 1);
+            if (end < in.size() && in[end] == '"') {
+                found = in.substr(at + 1, end - at - 1) == key;
+                at = end + 1;
+            } else {
+                std::string_view decoded;
+                std::string scratch;
+                const auto start = at;
+                if (!scan::string(in, at, decoded, scratch)) return failed(start, "object: Expected a key");
+                found = decoded == key;
+            }
+
+            at = scan::whitespace(in, at);
+            if (at >= in.size() || in[at] != ':') return failed(at, "object: Expected ':'");
+            at = scan::whitespace(in, at + 1);
+            if (found) return at < in.size() ? lazy(in, at) : failed(at, "value: No more input");
+
+            const char* what = nullptr;
+            if (!next(at, '}', what)) return what ? failed(at, what) : missing();
+        }
+    }
+
+    lazy operator[](std::size_t index) const {
+        if (!*this) return *this;
+        if (type() != kind::array) return missing();
+
+        std::size_t at = scan::whitespace(in, pos + 1);
+        if (at < in.size() && in[at] == ']') return missing();
+
+        for (const char* what = nullptr; index; --index) {
+            if (!next(at, ']', what)) return what ? failed(at, what) : missing();
+        }
+        return at < in.size() ? lazy(in, at) : failed(at, "value: No more input");
+    }
+
+    // Calls f(key, value) for every member of an object, with the key as
+    // written (escapes and all), until f returns false. True if it got to
+    // the end of the object.
+    template <typename F>
+    bool members(F&& f) const {
+        if (type() != kind::object) return false;
+
+        std::size_t at = scan::whitespace(in, pos + 1);
+        if (at < in.size() && in[at] == '}') return true;
+
+        while (true) {
+            const auto start = at;
+            if (at >= in.size() || in[at] != '"' || !scan::skip_value(in, at)) return false;
+            const auto key = in.substr(start + 1, at - start - 2);
+
+            at = scan::whitespace(in, at);
+            if (at >= in.size() || in[at] != ':') return false;
+            at = scan::whitespace(in, at + 1);
+            if (at >= in.size() || !f(key, lazy(in, at))) return false;
+
+            const char* what = nullptr;
+            if (!next(at, '}', what)) return !what;
+        }
+    }
+
+    // Calls f(value) for every element of an array, until f returns false.
+    // True if it got to the end of the array.
+    template <typename F>
+    bool elements(F&& f) const {
+        if (type() != kind::array) return false;
+
+        std::size_t at = scan::whitespace(in, pos + 1);
+        if (at < in.size() && in[at] == ']') return true;
+
+        while (true) {
+            if (at >= in.size() || !f(lazy(in, at))) return false;
+
+            const char* what = nullptr;
+            if (!next(at, ']', what)) return !what;
+        }
+    }
+
+    // The value as written, found by skipping it
+    std::string_view raw() const {
+        if (!*this) return {};
+        auto at = pos;
+        if (!scan::skip_value(in, at)) return {};
+        return in.substr(pos, at - pos);
+    }
+
+    std::optional<numeric> number() const {
+        numeric out;
+        auto at = pos;
+        if (type() != kind::number || !scan::number(in, at, out)) return std::nullopt;
+        return out;
+    }
+
+    std::optional<std::int64_t> int64() const {
+        const auto n = number();
+        if (!n || n->type() != numeric::kind::int64) return std::nullopt;
+        return n->int64();
+    }
+
+    std::optional<double> real() const {
+        const auto n = number();
+        if (!n) return std::nullopt;
+        return n->real();
+    }
+
+    // Unescaped
+    std::optional<std::string> string() const {
+        std::string_view decoded;
+        std::string scratch;
+        auto at = pos;
+        if (type() != kind::string || !scan::string(in, at, decoded, scratch)) return std::nullopt;
+        return std::string(decoded);
+    }
+
+private:
+    static constexpr std::size_t npos = std::string_view::npos;
+
+    lazy(const std::string_view in, const std::size_t pos) : in(in), pos(pos), at_error(pos) {}
+
+    lazy missing() const { return lazy(in, npos); }
+
+    lazy failed(const std::size_t at, const char* what) const {
+        auto out = missing();
+        out.at_error = at;
+        out.problem = what;
+        return out;
+    }
+
+    // Moves `at` from the start of a member value or element past it, to
+    // the start of the next one (true) or onto the closing bracket (false).
+    // `what` is set when the input turns out to be broken.
+    bool next(std::size_t& at, const char close, const char*& what) const {
+        if (!scan::skip_value(in, at)) {
+            what = "value: Could not skip";
+            return false;
+        }
+        at = scan::whitespace(in, at);
+        if (at < in.size() && in[at] == close) return false;
+        if (at >= in.size() || in[at] != ',') {
+            what = "container: Expected ',' or a closing bracket";
+            return false;
+        }
+        at = scan::whitespace(in, at + 1);
+        return true;
+    }
+
+    std::string_view in;
+    std::size_t pos = npos;
+    std::size_t at_error = 0;
+    const char* problem = nullptr;
+};
+
+} // namespace json
@@ -12,11 +12,11 @@ int main() {
   parsec::Parser object;
   parsec::Parser array;
 
-  array = [&object](const std::string in) {
+  array = [&object](const std::string_view in) {
     return parsec::Failure { " No good " };
   };
 
-  object = [&array](const std::string in) {
+  object = [&array](const std::string_view in) {
     return array(in);
   };
 
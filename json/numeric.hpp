@@ -0,0 +1,80 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <string_view>
+
+namespace json {
+
+// A number literal as scan::number leaves it: the digits have already been
+// folded into `mantissa` (scaled by 10^exponent) while the grammar was being
+// checked, so getting a value out never looks at the digits again unless the
+// literal has more significant digits than fit in 64 bits.
+struct numeric {
+    enum class kind { int64, uint64, float64, big };
+
+    std::string_view text;
+    std::uint64_t mantissa = 0;
+    std::int64_t exponent = 0;
+    bool negative = false;
+    // No fraction and no exponent in the literal
+    bool integral = true;
+    // Digits were dropped from `mantissa`, it is only an approximation
+    bool truncated = false;
+
+    // int64 whenever it fits, uint64 for the positive integers above that,
+    // big for integers that fit neither (only `text` is exact then).
+    kind type() const {
+        if (!integral) return kind::float64;
+        if (truncated) {
+            std::uint64_t u;
+            return !negative && parse_uint(u) ? kind::uint64 : kind::big;
+        }
+        if (negative) {
+            return mantissa <= std::uint64_t(std::numeric_limits<std::int64_t>::max()) + 1 ? kind::int64 : kind::big;
+        }
+        return mantissa <= std::uint64_t(std::numeric_limits<std::int64_t>::max()) ? kind::int64 : kind::uint64;
+    }
+
+    std::int64_t int64() const {
+        return negative ? std::int64_t(0 - mantissa) : std::int64_t(mantissa);
+    }
+
+    std::uint64_t uint64() const {
+        std::uint64_t u = mantissa;
+        if (truncated) parse_uint(u);
+        return u;
+    }
+
+    // Correctly rounded. Exact mantissas up to 2^53 with |exponent| <= 22 take
+    // Clinger's fast path (one exact multiply or divide), everything else goes
+    // through std::from_chars.
+    double real() const {
+        static constexpr double powers[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+        };
+
+        if (!truncated && mantissa <= (std::uint64_t(1) << 53) && exponent >= -22 && exponent <= 22) {
+            double d = double(mantissa);
+            d = exponent < 0 ? d / powers[-exponent] : d * powers[exponent];
+            return negative ? -d : d;
+        }
+
+        double d = 0;
+        if (std::from_chars(text.data(), text.data() + text.size(), d).ec == std::errc::result_out_of_range) {
+            d = exponent > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+            return negative ? -d : d;
+        }
+        return d;
+    }
+
+private:
+    bool parse_uint(std::uint64_t& u) const {
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), u);
+        return error == std::errc {} && end == text.data() + text.size();
+    }
+};
+
+} // namespace json
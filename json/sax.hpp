@@ -0,0 +1,168 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "./intern.hpp"
+#include "./scan.hpp"
+
+namespace json::sax {
+
+// Every callback is a no-op, so `parse(in, handler)` with this type is a pure
+// validator. Derive from it and shadow the callbacks you care about; calls
+// are resolved statically and inline into the grammar. Keys and strings are
+// unescaped, and the views are only valid for the duration of the call.
+struct handler {
+    void on_object_begin() {}
+    void on_object_end() {}
+    void on_array_begin() {}
+    void on_array_end() {}
+    void on_key(std::string_view) {}
+    void on_string(std::string_view) {}
+    void on_number(const numeric&) {}
+};
+
+template <typename Handler>
+class driver {
+public:
+    // Objects and arrays nested more than `max_depth` deep are an error rather
+    // than a stack overflow
+    driver(std::string_view in, Handler& h, key_pool* keys = nullptr, std::size_t max_depth = 512)
+        : in(in), h(h), keys(keys), max_depth(max_depth) {}
+
+    scan::status run() {
+        const bool ok = value();
+        if (keys) keys->record(interned);
+        if (!ok) return { pos, error };
+        return { pos };
+    }
+
+private:
+    bool fail(const char* what) {
+        error = what;
+        return false;
+    }
+
+    bool value() {
+        if (pos >= in.size()) return fail("value: No more input");
+
+        std::string_view text;
+        numeric number;
+        switch (in[pos]) {
+            case '{': return object();
+            case '[': return array();
+            case '"':
+                if (!scan::string(in, pos, text, scratch)) return fail("string: Unterminated or bad escape");
+                h.on_string(text);
+                return true;
+            default:
+                if (!scan::number(in, pos, number)) return fail("value: No alternative worked.");
+                h.on_number(number);
+                return true;
+        }
+    }
+
+    bool object() {
+        if (++depth > max_depth) return fail("object: Nested too deeply");
+        h.on_object_begin();
+        pos = scan::whitespace(in, pos + 1);
+        if (pos < in.size() && in[pos] == '}') {
+            ++pos;
+            --depth;
+            h.on_object_end();
+            return true;
+        }
+
+        std::string_view key;
+        while (true) {
+            std::uint64_t hash = 0;
+            const bool interning = keys && requires { h.on_key_id(key_id {}); };
+            if (!(interning ? scan_key(in, pos, key, scratch, hash) : scan::string(in, pos, key, scratch))) {
+                return fail("object: Expected a key");
+            }
+
+            if constexpr (requires { h.on_key_id(key_id {}); }) {
+                const auto id = interning ? keys->intern(key, hash, interned) : key_pool::none;
+                if (id != key_pool::none) {
+                    h.on_key_id(id);
+                } else {
+                    h.on_key(key);
+                }
+            } else {
+                h.on_key(key);
+            }
+
+            pos = scan::whitespace(in, pos);
+            if (pos >= in.size() || in[pos] != ':') return fail("object: Expected ':'");
+            pos = scan::whitespace(in, pos + 1);
+
+            if (!value()) return false;
+
+            pos = scan::whitespace(in, pos);
+            if (pos >= in.size()) return fail("object: No more input");
+            if (in[pos] == '}') break;
+            if (in[pos] != ',') return fail("object: Expected ',' or '}'");
+            pos = scan::whitespace(in, pos + 1);
+        }
+
+        ++pos;
+        --depth;
+        h.on_object_end();
+        return true;
+    }
+
+    bool array() {
+        if (++depth > max_depth) return fail("array: Nested too deeply");
+        h.on_array_begin();
+        pos = scan::whitespace(in, pos + 1);
+        if (pos < in.size() && in[pos] == ']') {
+            ++pos;
+            --depth;
+            h.on_array_end();
+            return true;
+        }
+
+        while (true) {
+            if (!value()) return false;
+
+            pos = scan::whitespace(in, pos);
+            if (pos >= in.size()) return fail("array: No more input");
+            if (in[pos] == ']') break;
+            if (in[pos] != ',') return fail("array: Expected ',' or ']'");
+            pos = scan::whitespace(in, pos + 1);
+        }
+
+        ++pos;
+        --depth;
+        h.on_array_end();
+        return true;
+    }
+
+    std::string_view in;
+    Handler& h;
+    key_pool* keys;
+    key_pool::tally interned;
+    std::size_t max_depth;
+    std::size_t depth = 0;
+    std::size_t pos = 0;
+    const char* error = nullptr;
+    std::string scratch;
+};
+
+// Drives `h` through the same grammar as json::parser() without building any
+// output. On success the status offset is the number of bytes consumed, on
+// failure it is where parsing stopped.
+template <typename Handler = handler>
+scan::status parse(std::string_view in, Handler&& h = {}) {
+    return driver<std::remove_reference_t<Handler>> { in, h }.run();
+}
+
+// As above, but a handler with an `on_key_id(key_id)` callback gets keys as
+// ids interned in `keys` (and on_key only for keys the full pool turned away).
+template <typename Handler = handler>
+scan::status parse(std::string_view in, key_pool& keys, Handler&& h = {}) {
+    return driver<std::remove_reference_t<Handler>> { in, h, &keys }.run();
+}
+
+} // namespace json::sax
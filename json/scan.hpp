@@ -0,0 +1,465 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "../parsec_scan.hpp"
+#include "./numeric.hpp"
+
+// Hand written versions of the token rules in json.hpp (whitespace, string,
+// number). They work on a view and an offset so the streaming front ends
+// (events, sax, ...) can walk a document without building parsec::Success
+// strings along the way.
+namespace json::scan {
+
+using parsec::scan::status;
+using parsec::scan::prefix_xor;
+
+bool is_whitespace(const char in) {
+    return in == ' ' || in == '\t' || in == '\n' || in == '\r';
+}
+
+bool is_digit(const char in) {
+    return in >= '0' && in <= '9';
+}
+
+bool is_hex(const char in) {
+    return (in >= '0' && in <= '9')
+        || (in >= 'A' && in <= 'F')
+        || (in >= 'a' && in <= 'f');
+}
+
+std::size_t whitespace(std::string_view in, std::size_t pos) {
+    while (pos < in.size() && is_whitespace(in[pos])) ++pos;
+    return pos;
+}
+
+// True when all eight bytes of a little endian word are ASCII digits
+constexpr bool eight_digits(const std::uint64_t word) {
+    return !(((word + 0x4646464646464646ull) | (word - 0x3030303030303030ull)) & 0x8080808080808080ull);
+}
+
+// The value of eight ASCII digits (first digit in the lowest byte), three
+// multiplies instead of eight multiply-adds.
+constexpr std::uint64_t eight_digit_value(std::uint64_t word) {
+    constexpr std::uint64_t mask = 0x000000FF000000FFull;
+    constexpr std::uint64_t mul1 = 0x000F424000000064ull; // 100 + (1000000 << 32)
+    constexpr std::uint64_t mul2 = 0x0000271000000001ull; // 1 + (10000 << 32)
+
+    word -= 0x3030303030303030ull;
+    word = (word * 10) + (word >> 8);
+    return (((word & mask) * mul1) + (((word >> 16) & mask) * mul2)) >> 32;
+}
+
+// Same shape as json::number: -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?
+// The digits are folded into `out` while they are being checked.
+bool number(std::string_view in, std::size_t& pos, numeric& out) {
+    constexpr std::uint64_t room_for_eight = 100000000000ull; // 10^11 * 10^8 < 2^64
+    constexpr std::uint64_t room_for_one = 1000000000000000000ull; // 10^18 * 10 < 2^64
+
+    std::size_t at = pos;
+    out = numeric {};
+
+    // Digits that no longer fit are dropped, and counted in the exponent when
+    // they are in front of the decimal point.
+    const auto digits = [&in, &at, &out](const bool fraction) {
+        const std::size_t start = at;
+        if constexpr (std::endian::native == std::endian::little) {
+            while (at + 8 <= in.size() && out.mantissa < room_for_eight) {
+                std::uint64_t word;
+                std::memcpy(&word, in.data() + at, 8);
+                if (!eight_digits(word)) break;
+                out.mantissa = out.mantissa * 100000000 + eight_digit_value(word);
+                at += 8;
+                if (fraction) out.exponent -= 8;
+            }
+        }
+        for (; at < in.size() && is_digit(in[at]); ++at) {
+            if (out.mantissa < room_for_one) {
+                out.mantissa = out.mantissa * 10 + (in[at] - '0');
+                if (fraction) --out.exponent;
+            } else {
+                out.truncated = true;
+                if (!fraction) ++out.exponent;
+            }
+        }
+        return at != start;
+    };
+
+    if (at < in.size() && in[at] == '-') {
+        out.negative = true;
+        ++at;
+    }
+
+    if (at >= in.size() || !is_digit(in[at])) return false;
+    if (in[at] == '0') {
+        ++at;
+    } else {
+        digits(false);
+    }
+
+    if (at < in.size() && in[at] == '.') {
+        out.integral = false;
+        ++at;
+        if (!digits(true)) return false;
+    }
+
+    if (at < in.size() && (in[at] == 'e' || in[at] == 'E')) {
+        out.integral = false;
+        ++at;
+
+        bool negative = false;
+        if (at < in.size() && (in[at] == '-' || in[at] == '+')) negative = in[at++] == '-';
+        if (at >= in.size() || !is_digit(in[at])) return false;
+
+        std::int64_t exponent = 0;
+        for (; at < in.size() && is_digit(in[at]); ++at) {
+            // Anything this large is 0 or infinity anyway
+            if (exponent < 100000) exponent = exponent * 10 + (in[at] - '0');
+        }
+        out.exponent += negative ? -exponent : exponent;
+    }
+
+    out.text = in.substr(pos, at - pos);
+    pos = at;
+    return true;
+}
+
+// SWAR helpers: `matches(word, c)` flags (in the high bit) the bytes of a
+// little endian word equal to `c`. Only the lowest flag is guaranteed exact,
+// which is all the "find first" loops below need.
+constexpr std::uint64_t ones = 0x0101010101010101ull;
+
+constexpr std::uint64_t matches(const std::uint64_t word, const unsigned char c) {
+    const auto v = word ^ (ones * c);
+    return (v - ones) & ~v & (ones * 0x80);
+}
+
+std::uint64_t load(const char* at) {
+    std::uint64_t word;
+    std::memcpy(&word, at, 8);
+    return word;
+}
+
+// Index of the first quote or backslash at or after `at` (in.size() if none).
+std::size_t next_quote_or_escape(std::string_view in, std::size_t at) {
+    if constexpr (std::endian::native == std::endian::little) {
+        for (; at + 8 <= in.size(); at += 8) {
+            const auto word = load(in.data() + at);
+            const auto hits = matches(word, '"') | matches(word, '\\');
+            if (hits) return at + std::countr_zero(hits) / 8;
+        }
+    }
+
+    while (at < in.size() && in[at] != '"' && in[at] != '\\') ++at;
+    return at;
+}
+
+// Flags for the bytes of a little endian word that string() has to look at
+// (see next_special), with the same caveat as matches()
+constexpr std::uint64_t specials(const std::uint64_t word) {
+    return matches(word, '"') | matches(word, '\\')
+        | ((word - ones * 0x20) & ~word & (ones * 0x80)) // below 0x20
+        | (word & (ones * 0x80));
+}
+
+// Index of the first byte at or after `at` that string() has to look at:
+// a quote, a backslash, a control character or any non-ASCII byte.
+std::size_t next_special(std::string_view in, std::size_t at) {
+#if defined(__SSE2__)
+    for (; at + 16 <= in.size(); at += 16) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in.data() + at));
+        const auto control = _mm_cmpeq_epi8(_mm_max_epu8(bytes, _mm_set1_epi8(0x1F)), _mm_set1_epi8(0x1F));
+        const auto special = _mm_or_si128(control, _mm_or_si128(
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+            _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))));
+        // movemask also picks up the high bit of every non-ASCII byte
+        const int hits = _mm_movemask_epi8(special) | _mm_movemask_epi8(bytes);
+        if (hits) return at + std::countr_zero(static_cast<unsigned>(hits));
+    }
+#endif
+    if constexpr (std::endian::native == std::endian::little) {
+        for (; at + 8 <= in.size(); at += 8) {
+            if (const auto hits = specials(load(in.data() + at))) return at + std::countr_zero(hits) / 8;
+        }
+    }
+
+    for (; at < in.size(); ++at) {
+        const auto c = static_cast<unsigned char>(in[at]);
+        if (c == '"' || c == '\\' || c < 0x20 || c >= 0x80) break;
+    }
+    return at;
+}
+
+// Length of the well formed UTF-8 sequence at `at`, 0 if there is none
+// (overlong forms, surrogates and code points past U+10FFFF are rejected).
+std::size_t utf8_sequence(std::string_view in, std::size_t at) {
+    const auto byte = [&in](std::size_t i) -> unsigned {
+        return i < in.size() ? static_cast<unsigned char>(in[i]) : 0;
+    };
+    const auto continuation = [&byte](std::size_t i) { return (byte(i) & 0xC0) == 0x80; };
+
+    const unsigned lead = byte(at);
+    const unsigned next = byte(at + 1);
+    if (lead >= 0xC2 && lead <= 0xDF) return continuation(at + 1) ? 2 : 0;
+    if (lead >= 0xE0 && lead <= 0xEF) {
+        if (lead == 0xE0 && next < 0xA0) return 0;
+        if (lead == 0xED && next > 0x9F) return 0;
+        return continuation(at + 1) && continuation(at + 2) ? 3 : 0;
+    }
+    if (lead >= 0xF0 && lead <= 0xF4) {
+        if (lead == 0xF0 && next < 0x90) return 0;
+        if (lead == 0xF4 && next > 0x8F) return 0;
+        return continuation(at + 1) && continuation(at + 2) && continuation(at + 3) ? 4 : 0;
+    }
+    return 0;
+}
+
+void append_utf8(std::string& out, std::uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(char(cp));
+    } else if (cp < 0x800) {
+        out.push_back(char(0xC0 | (cp >> 6)));
+        out.push_back(char(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(char(0xE0 | (cp >> 12)));
+        out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(char(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(char(0xF0 | (cp >> 18)));
+        out.push_back(char(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(char(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(char(0x80 | (cp & 0x3F)));
+    }
+}
+
+// The four hex digits after "\u" at `at`, -1 if they are not there
+std::int32_t hex4(std::string_view in, std::size_t at) {
+    if (at + 4 > in.size()) return -1;
+
+    std::int32_t value = 0;
+    for (std::size_t i = at; i < at + 4; ++i) {
+        const char c = in[i];
+        if (!is_hex(c)) return -1;
+        value = value * 16 + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+    }
+    return value;
+}
+
+// `pos` points at the opening quote. On success `pos` is moved past the
+// closing quote and `contents` is the decoded text: a view into `in` when the
+// string has no escapes, otherwise a view of `scratch`, which holds the
+// unescaped copy. Plain runs are found 16 bytes at a time and copied in bulk;
+// "\uXXXX" pairs are joined into one code point (a lone surrogate becomes
+// U+FFFD) and raw bytes must be well formed UTF-8 with no control characters.
+bool string(std::string_view in, std::size_t& pos, std::string_view& contents, std::string& scratch) {
+    if (pos >= in.size() || in[pos] != '"') return false;
+
+    bool unescaped = false;
+    std::size_t run = pos + 1;
+    std::size_t at = run;
+
+    while ((at = next_special(in, at)) < in.size()) {
+        const auto c = static_cast<unsigned char>(in[at]);
+
+        if (c == '"') {
+            if (unescaped) {
+                scratch.append(in.data() + run, at - run);
+                contents = scratch;
+            } else {
+                contents = in.substr(run, at - run);
+            }
+            pos = at + 1;
+            return true;
+        }
+
+        if (c >= 0x80) {
+            const auto length = utf8_sequence(in, at);
+            if (length == 0) return false;
+            at += length;
+            continue;
+        }
+
+        if (c != '\\') return false; // control character
+
+        if (!unescaped) {
+            unescaped = true;
+            scratch.clear();
+        }
+        scratch.append(in.data() + run, at - run);
+
+        if (at + 1 >= in.size()) return false;
+        switch (in[at + 1]) {
+            case '"': scratch.push_back('"'); break;
+            case '\\': scratch.push_back('\\'); break;
+            case '/': scratch.push_back('/'); break;
+            case 'b': scratch.push_back('\b'); break;
+            case 'f': scratch.push_back('\f'); break;
+            case 'n': scratch.push_back('\n'); break;
+            case 'r': scratch.push_back('\r'); break;
+            case 't': scratch.push_back('\t'); break;
+            case 'u': {
+                std::int32_t cp = hex4(in, at + 2);
+                if (cp < 0) return false;
+                at += 4;
+
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    const auto low = at + 3 < in.size() && in[at + 2] == '\\' && in[at + 3] == 'u' ? hex4(in, at + 4) : -1;
+                    if (low >= 0xDC00 && low <= 0xDFFF) {
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        at += 6;
+                    } else {
+                        cp = 0xFFFD;
+                    }
+                } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                    cp = 0xFFFD;
+                }
+                append_utf8(scratch, std::uint32_t(cp));
+                break;
+            }
+            default:
+                return false;
+        }
+
+        at += 2;
+        run = at;
+    }
+
+    return false;
+}
+
+// Bitmasks (bit i for byte i) of the interesting bytes in a 64 byte block.
+struct block {
+    std::uint64_t quote = 0;
+    std::uint64_t backslash = 0;
+    std::uint64_t open = 0;
+    std::uint64_t close = 0;
+
+    explicit block(const char* at) {
+#if defined(__SSE2__)
+        for (int i = 0; i < 4; ++i) {
+            const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(at + 16 * i));
+            const auto folded = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+            const auto mask = [](const __m128i eq) {
+                return static_cast<std::uint64_t>(static_cast<std::uint16_t>(_mm_movemask_epi8(eq)));
+            };
+            quote |= mask(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"'))) << (16 * i);
+            backslash |= mask(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))) << (16 * i);
+            open |= mask(_mm_cmpeq_epi8(folded, _mm_set1_epi8('{'))) << (16 * i);
+            close |= mask(_mm_cmpeq_epi8(folded, _mm_set1_epi8('}'))) << (16 * i);
+        }
+#else
+        for (int i = 0; i < 64; ++i) {
+            const std::uint64_t bit = std::uint64_t(1) << i;
+            const char c = at[i];
+            quote |= c == '"' ? bit : 0;
+            backslash |= c == '\\' ? bit : 0;
+            open |= (c == '{' || c == '[') ? bit : 0;
+            close |= (c == '}' || c == ']') ? bit : 0;
+        }
+#endif
+    }
+};
+
+// Bits of the characters escaped by a backslash, carrying an odd run of
+// backslashes over from the previous block in `carry` (the simdjson trick).
+std::uint64_t escaped(std::uint64_t backslash, std::uint64_t& carry) {
+    constexpr std::uint64_t even = 0x5555555555555555ull;
+
+    backslash &= ~carry;
+    const std::uint64_t follows = backslash << 1 | carry;
+    const std::uint64_t odd_starts = backslash & ~even & ~follows;
+    std::uint64_t even_starts;
+    carry = __builtin_add_overflow(odd_starts, backslash, &even_starts);
+    return (even ^ (even_starts << 1)) & follows;
+}
+
+// Moves `pos` from an opening bracket to just past its partner, 64 bytes per
+// step: brackets inside strings are masked out with the usual quote/escape
+// bit tricks, and a block that cannot close the container only updates the
+// depth with two popcounts.
+bool skip_container(std::string_view in, std::size_t& pos) {
+    std::uint64_t escape_carry = 0;
+    std::uint64_t in_string = 0;
+    std::int64_t depth = 0;
+
+    for (std::size_t at = pos; at < in.size(); at += 64) {
+        char padded[64];
+        const char* bytes = in.data() + at;
+        if (in.size() - at < 64) {
+            std::memset(padded, ' ', 64);
+            std::memcpy(padded, bytes, in.size() - at);
+            bytes = padded;
+        }
+
+        const block b { bytes };
+        const auto quotes = b.quote & ~escaped(b.backslash, escape_carry);
+        const auto strings = prefix_xor(quotes) ^ in_string;
+        in_string = static_cast<std::uint64_t>(static_cast<std::int64_t>(strings) >> 63);
+
+        auto open = b.open & ~strings;
+        auto close = b.close & ~strings;
+        if (depth > std::popcount(close)) {
+            depth += std::popcount(open) - std::popcount(close);
+            continue;
+        }
+
+        for (auto brackets = open | close; brackets; brackets &= brackets - 1) {
+            const auto bit = brackets & -brackets;
+            depth += (open & bit) ? 1 : -1;
+            if (depth == 0) {
+                pos = at + std::countr_zero(bit) + 1;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+// Moves `pos` past the value starting there by balancing brackets and quotes
+// only. Nothing inside is validated, which is what makes it cheap: use it for
+// values the caller is going to throw away anyway.
+bool skip_value(std::string_view in, std::size_t& pos) {
+    std::size_t at = pos;
+    if (at >= in.size()) return false;
+
+    // `at` is on an opening quote, afterwards it is just past the closing one
+    const auto skip_string = [&in, &at]() -> bool {
+        ++at;
+        while ((at = next_quote_or_escape(in, at)) < in.size()) {
+            if (in[at] == '"') { ++at; return true; }
+            at += 2;
+        }
+        return false;
+    };
+
+    switch (in[at]) {
+        case '"':
+            if (!skip_string()) return false;
+            break;
+        case '{':
+        case '[':
+            return skip_container(in, pos);
+        default:
+            while (at < in.size()) {
+                const char c = in[at];
+                if (c == ',' || c == '}' || c == ']' || is_whitespace(c)) break;
+                ++at;
+            }
+            if (at == pos) return false;
+    }
+
+    pos = at;
+    return true;
+}
+
+} // namespace json::scan
@@ -0,0 +1,335 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./scan.hpp"
+
+namespace json {
+
+// Describes the members of a struct that json::read() fills in. Specialize it
+// with a `fields` table:
+//
+//   template <> struct json::schema<user> {
+//       static constexpr auto fields = json::fields(
+//           json::field("id", &user::id),
+//           json::field("name", &user::name),
+//           json::field("email", &user::email));
+//   };
+//
+// Members can be integers, floating point numbers, std::string, structs with
+// a schema of their own, and std::vector or std::optional of any of those.
+// Every member that isn't a std::optional is required.
+template <typename T>
+struct schema;
+
+template <typename T> struct is_optional : std::false_type {};
+template <typename T> struct is_optional<std::optional<T>> : std::true_type {};
+template <typename T> struct is_vector : std::false_type {};
+template <typename T> struct is_vector<std::vector<T>> : std::true_type {};
+
+template <typename S, typename M>
+struct named_member {
+    static constexpr bool optional = is_optional<M>::value;
+
+    std::string_view name;
+    M S::* member;
+};
+
+template <typename S, typename M>
+constexpr named_member<S, M> field(const std::string_view name, M S::* member) {
+    return { name, member };
+}
+
+// The first and last eight bytes of a key and its length, folded into a
+// word. Keys that agree on all three can't be told apart by key_table.
+constexpr std::uint64_t key_bits(const std::string_view key) {
+    const auto load = [&key](const std::size_t at, const std::size_t n) {
+        std::uint64_t word = 0;
+        if constexpr (std::endian::native == std::endian::little) {
+            if (!std::is_constant_evaluated() && n == 8) {
+                std::memcpy(&word, key.data() + at, 8);
+                return word;
+            }
+        }
+        for (std::size_t i = 0; i < n; ++i) word |= std::uint64_t(std::uint8_t(key[at + i])) << (8 * i);
+        return word;
+    };
+
+    const auto size = key.size();
+    const auto head = load(0, size < 8 ? size : 8);
+    const auto tail = size > 8 ? load(size - 8, 8) : 0;
+    return head ^ std::rotl(tail * 0x9E3779B97F4A7C15ull, 32) ^ size * 0xC2B2AE3D27D4EB4Full;
+}
+
+// Not constexpr, so reaching it while building a key_table stops compilation
+void keys_must_be_unique_in_their_first_and_last_eight_bytes();
+
+// A perfect hash of N keys, found at compile time: one multiply and shift
+// takes key_bits(key) to a slot that only that key can be in, and a single
+// comparison tells whether it is that key or one the table doesn't know.
+template <std::size_t N>
+struct key_table {
+    static_assert(N < 255, "key_table: Too many keys");
+    static constexpr int max_bits = std::bit_width(N) + 2;
+
+    std::array<std::string_view, N> names;
+    std::uint64_t multiplier = 0;
+    int shift = 63;
+    // Index + 1 of the key in each slot, 0 for none
+    std::array<std::uint8_t, std::size_t(1) << max_bits> slots {};
+
+    constexpr key_table(const std::array<std::string_view, N>& keys) : names(keys) {
+        std::uint64_t seed = 0;
+        for (int bits = std::max(1, max_bits - 2); bits <= max_bits; ++bits) {
+            for (int attempt = 0; attempt < 256; ++attempt) {
+                // splitmix64, for multipliers that are spread out
+                auto m = (seed += 0x9E3779B97F4A7C15ull);
+                m = (m ^ (m >> 30)) * 0xBF58476D1CE4E5B9ull;
+                m = (m ^ (m >> 27)) * 0x94D049BB133111EBull;
+                multiplier = (m ^ (m >> 31)) | 1;
+                shift = 64 - bits;
+                if (fill()) return;
+            }
+        }
+        keys_must_be_unique_in_their_first_and_last_eight_bytes();
+    }
+
+    // Index of `key`, N if it isn't one of the keys
+    constexpr std::size_t find(const std::string_view key) const {
+        const auto slot = slots[(key_bits(key) * multiplier) >> shift];
+        return slot && names[slot - 1] == key ? slot - 1 : N;
+    }
+
+private:
+    constexpr bool fill() {
+        slots = {};
+        for (std::size_t i = 0; i < N; ++i) {
+            auto& slot = slots[(key_bits(names[i]) * multiplier) >> shift];
+            if (slot) return false;
+            slot = std::uint8_t(i + 1);
+        }
+        return true;
+    }
+};
+
+template <typename... Members>
+struct field_table {
+    static constexpr std::size_t size = sizeof...(Members);
+    static_assert(size <= 64, "field_table: At most 64 fields");
+
+    std::tuple<Members...> members;
+    key_table<size> keys;
+    // Bit i for every member i that isn't a std::optional
+    std::uint64_t required;
+};
+
+template <typename... Members>
+constexpr field_table<Members...> fields(const Members... members) {
+    std::uint64_t required = 0;
+    std::size_t i = 0;
+    ((required |= std::uint64_t(!Members::optional) << i++), ...);
+    return { { members... }, key_table<sizeof...(Members)>({ members.name... }), required };
+}
+
+struct read_status {
+    std::size_t offset = 0;
+    const char* error = nullptr;
+    // The member that was being read when it failed, or the required member
+    // that was missing
+    std::string_view field {};
+
+    explicit operator bool() const { return error == nullptr; }
+};
+
+// Parses a document straight into a struct with a schema: keys go through
+// the schema's key_table, values are converted as they are scanned, and
+// fields the schema doesn't mention are passed over with scan::skip_value
+// without being validated. Optional members the document leaves out are
+// reset, and vectors are read into the elements they already have, so
+// reading into the same struct again reuses its strings and vectors.
+class reader {
+public:
+    // Objects and arrays nested more than `max_depth` deep are an error, for
+    // structs that hold vectors or optionals of themselves
+    explicit reader(const std::string_view in, const std::size_t max_depth = 512) : in(in), max_depth(max_depth) {}
+
+    template <typename T>
+    read_status run(T& out) {
+        if (!value(out)) return { pos, error, field };
+        return { pos };
+    }
+
+private:
+    bool fail(const char* what) {
+        error = what;
+        return false;
+    }
+
+    template <typename T>
+    bool value(T& out) {
+        if (pos >= in.size()) return fail("value: No more input");
+
+        if constexpr (std::is_integral_v<T>) {
+            static_assert(!std::is_same_v<T, bool>, "reader: The grammar has no booleans");
+            numeric number;
+            if (!scan::number(in, pos, number)) return fail("number: Expected a number");
+            if (!number.integral) return fail("number: Expected an integer");
+
+            const auto kind = number.type();
+            if constexpr (std::is_signed_v<T>) {
+                if (kind != numeric::kind::int64) return fail("number: Out of range");
+                const auto v = number.int64();
+                if (v < std::numeric_limits<T>::min() || v > std::numeric_limits<T>::max()) return fail("number: Out of range");
+                out = T(v);
+            } else {
+                if (kind == numeric::kind::big || (number.negative && number.mantissa)) return fail("number: Out of range");
+                const auto v = kind == numeric::kind::int64 ? std::uint64_t(number.int64()) : number.uint64();
+                if (v > std::numeric_limits<T>::max()) return fail("number: Out of range");
+                out = T(v);
+            }
+            return true;
+        } else if constexpr (std::is_floating_point_v<T>) {
+            numeric number;
+            if (!scan::number(in, pos, number)) return fail("number: Expected a number");
+            out = T(number.real());
+            return true;
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            std::string_view text;
+            if (!scan::string(in, pos, text, scratch)) return fail("string: Expected a valid string");
+            out.assign(text);
+            return true;
+        } else if constexpr (is_optional<T>::value) {
+            return value(out.emplace());
+        } else if constexpr (is_vector<T>::value) {
+            return array(out);
+        } else {
+            return object(out);
+        }
+    }
+
+    template <typename T>
+    bool array(std::vector<T>& out) {
+        if (in[pos] != '[') return fail("array: Expected '['");
+        if (++depth > max_depth) return fail("array: Nested too deeply");
+        pos = scan::whitespace(in, pos + 1);
+        if (pos < in.size() && in[pos] == ']') {
+            ++pos;
+            --depth;
+            out.clear();
+            return true;
+        }
+
+        std::size_t n = 0;
+        while (true) {
+            if (n == out.size()) out.emplace_back();
+            if (!value(out[n++])) return false;
+
+            pos = scan::whitespace(in, pos);
+            if (pos >= in.size()) return fail("array: No more input");
+            if (in[pos] == ']') break;
+            if (in[pos] != ',') return fail("array: Expected ',' or ']'");
+            pos = scan::whitespace(in, pos + 1);
+        }
+
+        ++pos;
+        --depth;
+        out.resize(n);
+        return true;
+    }
+
+    template <typename T>
+    bool object(T& out) {
+        static constexpr const auto& table = schema<T>::fields;
+
+        if (in[pos] != '{') return fail("object: Expected '{'");
+        if (++depth > max_depth) return fail("object: Nested too deeply");
+        pos = scan::whitespace(in, pos + 1);
+
+        std::uint64_t seen = 0;
+        if (pos < in.size() && in[pos] == '}') {
+            ++pos;
+        } else {
+            std::string_view key;
+            while (true) {
+                if (!scan::string(in, pos, key, scratch)) return fail("object: Expected a key");
+                const auto index = table.keys.find(key);
+
+                pos = scan::whitespace(in, pos);
+                if (pos >= in.size() || in[pos] != ':') return fail("object: Expected ':'");
+                pos = scan::whitespace(in, pos + 1);
+
+                if (index == table.size) {
+                    if (!scan::skip_value(in, pos)) return fail("value: Could not skip");
+                } else {
+                    seen |= std::uint64_t(1) << index;
+                    if (!member(out, table, index, std::make_index_sequence<table.size> {})) return false;
+                }
+
+                pos = scan::whitespace(in, pos);
+                if (pos >= in.size()) return fail("object: No more input");
+                if (in[pos] == '}') break;
+                if (in[pos] != ',') return fail("object: Expected ',' or '}'");
+                pos = scan::whitespace(in, pos + 1);
+            }
+            ++pos;
+        }
+        --depth;
+
+        if (const auto missing = table.required & ~seen) {
+            field = table.keys.names[std::countr_zero(missing)];
+            return fail("object: Missing a required field");
+        }
+        absent(out, table, seen, std::make_index_sequence<table.size> {});
+        return true;
+    }
+
+    // Resets the optional members that weren't in the object
+    template <typename T, typename Table, std::size_t... I>
+    void absent(T& out, const Table& table, const std::uint64_t seen, std::index_sequence<I...>) {
+        const auto reset = [&out, seen](const auto& m, const std::size_t i) {
+            if constexpr (std::remove_cvref_t<decltype(m)>::optional) {
+                if (!(seen >> i & 1)) (out.*m.member).reset();
+            }
+        };
+        (reset(std::get<I>(table.members), I), ...);
+    }
+
+    template <typename T, typename Table, std::size_t... I>
+    bool member(T& out, const Table& table, const std::size_t index, std::index_sequence<I...>) {
+        bool ok = true;
+        ((I == index ? (ok = value(out.*std::get<I>(table.members).member), 0) : 0), ...);
+        // The innermost member is the one that gets reported
+        if (!ok && field.empty()) field = table.keys.names[index];
+        return ok;
+    }
+
+    std::string_view in;
+    std::size_t max_depth;
+    std::size_t depth = 0;
+    std::size_t pos = 0;
+    const char* error = nullptr;
+    std::string_view field;
+    std::string scratch;
+};
+
+// Fills in `out` from the value at the start of `in`. On success the offset
+// is the number of bytes consumed, on failure it is where reading stopped.
+template <typename T>
+read_status read(const std::string_view in, T& out) {
+    return reader { in }.run(out);
+}
+
+} // namespace json
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "./sax.hpp"
+#include "./scan.hpp"
+
+namespace json {
+
+// A set of JSON Pointers (RFC 6901) stored as a trie over reference tokens.
+// Pointers that aren't valid (not starting with '/', or a '~' that isn't
+// "~0" or "~1") are left out and listed by rejected().
+class pointer_set {
+public:
+    static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    struct node {
+        std::map<std::string, std::size_t, std::less<>> children;
+        // The children whose token is an array index as well, by number
+        std::map<std::size_t, std::size_t> elements;
+        // Index of the pointer that ends here, npos for interior nodes
+        std::size_t selected = npos;
+    };
+
+    pointer_set(const std::vector<std::string>& pointers) : nodes(1) {
+        for (std::size_t i = 0; i < pointers.size(); ++i) {
+            if (!add(pointers[i], i)) invalid.push_back(i);
+        }
+    }
+
+    const node& at(std::size_t n) const { return nodes[n]; }
+
+    std::optional<std::size_t> child(std::size_t n, std::string_view token) const {
+        const auto& children = nodes[n].children;
+        const auto found = children.find(token);
+        if (found == children.end()) return std::nullopt;
+        return found->second;
+    }
+
+    std::optional<std::size_t> element(std::size_t n, std::size_t index) const {
+        const auto& elements = nodes[n].elements;
+        const auto found = elements.find(index);
+        if (found == elements.end()) return std::nullopt;
+        return found->second;
+    }
+
+    // Indexes of the pointers that weren't valid
+    const std::vector<std::size_t>& rejected() const { return invalid; }
+
+private:
+    bool add(std::string_view pointer, std::size_t index) {
+        // A pointer is either "" (the whole document) or "/token/..."
+        std::vector<std::string> tokens;
+        while (!pointer.empty()) {
+            if (pointer[0] != '/') return false;
+            pointer.remove_prefix(1);
+            const auto end = pointer.find('/');
+            const auto token = unescape(pointer.substr(0, end));
+            if (!token) return false;
+            tokens.push_back(*token);
+            pointer = end == std::string_view::npos ? std::string_view {} : pointer.substr(end);
+        }
+
+        std::size_t n = 0;
+        for (const auto& token : tokens) {
+            auto next = child(n, token);
+            if (!next) {
+                next = nodes.size();
+                nodes[n].children.emplace(token, *next);
+                if (const auto i = array_index(token)) nodes[n].elements.emplace(*i, *next);
+                nodes.emplace_back();
+            }
+            n = *next;
+        }
+        nodes[n].selected = index;
+        return true;
+    }
+
+    static std::optional<std::string> unescape(std::string_view token) {
+        std::string out;
+        for (std::size_t i = 0; i < token.size(); ++i) {
+            if (token[i] != '~') {
+                out.push_back(token[i]);
+                continue;
+            }
+            if (i + 1 == token.size() || (token[i + 1] != '0' && token[i + 1] != '1')) return std::nullopt;
+            out.push_back(token[++i] == '1' ? '/' : '~');
+        }
+        return out;
+    }
+
+    // "0" or digits without a leading zero, as RFC 6901 writes array indexes
+    static std::optional<std::size_t> array_index(std::string_view token) {
+        if (token.empty() || (token[0] == '0' && token.size() > 1)) return std::nullopt;
+        std::size_t value = 0;
+        const auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+        if (ec != std::errc {} || end != token.data() + token.size()) return std::nullopt;
+        return value;
+    }
+
+    std::vector<node> nodes;
+    std::vector<std::size_t> invalid;
+};
+
+namespace sax {
+
+// Walks only as much structure as is needed to reach the selected pointers.
+// Selected values are parsed by the full grammar and reported to `h`
+// (preceded by `h.on_path(index)` when the handler has one); everything else
+// is passed over with scan::skip_value and never validated.
+template <typename Handler>
+class selector {
+public:
+    selector(std::string_view in, const pointer_set& paths, Handler& h) : in(in), paths(paths), h(h) {}
+
+    scan::status run() {
+        if (!paths.rejected().empty()) return { 0, "pointer: Not a valid JSON Pointer" };
+        if (!value(0)) return { pos, error };
+        return { pos };
+    }
+
+private:
+    bool fail(const char* what) {
+        error = what;
+        return false;
+    }
+
+    bool value(const std::size_t n) {
+        const auto& node = paths.at(n);
+
+        if (node.selected != pointer_set::npos) {
+            if constexpr (requires { h.on_path(node.selected); }) h.on_path(node.selected);
+            const auto status = parse(in.substr(pos), h);
+            if (!status) {
+                pos += status.offset;
+                return fail(status.error);
+            }
+            pos += status.offset;
+            return true;
+        }
+
+        if (pos >= in.size()) return fail("value: No more input");
+        if (node.children.empty() || (in[pos] != '{' && in[pos] != '[')) {
+            if (!scan::skip_value(in, pos)) return fail("value: Could not skip");
+            return true;
+        }
+
+        const char close = in[pos] == '{' ? '}' : ']';
+        pos = scan::whitespace(in, pos + 1);
+        if (pos < in.size() && in[pos] == close) {
+            ++pos;
+            return true;
+        }
+
+        std::size_t index = 0;
+        std::string_view key;
+        while (true) {
+            std::optional<std::size_t> next;
+            if (close == '}') {
+                if (!scan::string(in, pos, key, scratch)) return fail("object: Expected a key");
+                next = paths.child(n, key);
+
+                pos = scan::whitespace(in, pos);
+                if (pos >= in.size() || in[pos] != ':') return fail("object: Expected ':'");
+                pos = scan::whitespace(in, pos + 1);
+            } else {
+                next = paths.element(n, index++);
+            }
+
+            if (next) {
+                if (!value(*next)) return false;
+            } else if (!scan::skip_value(in, pos)) {
+                return fail("value: Could not skip");
+            }
+
+            pos = scan::whitespace(in, pos);
+            if (pos >= in.size()) return fail("container: No more input");
+            if (in[pos] == close) break;
+            if (in[pos] != ',') return fail("container: Expected ',' or a closing bracket");
+            pos = scan::whitespace(in, pos + 1);
+        }
+
+        ++pos;
+        return true;
+    }
+
+    std::string_view in;
+    const pointer_set& paths;
+    Handler& h;
+    std::size_t pos = 0;
+    const char* error = nullptr;
+    std::string scratch;
+};
+
+template <typename Handler = handler>
+scan::status select(std::string_view in, const pointer_set& paths, Handler&& h = {}) {
+    return selector<std::remove_reference_t<Handler>> { in, paths, h }.run();
+}
+
+} // namespace sax
+
+} // namespace json
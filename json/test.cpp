@@ -1,6 +1,21 @@
 #include <catch2/catch_test_macros.hpp>
 #include "../parsec.hpp"
 #include "./json.hpp"
+#include "../alloc.hpp"
+#include "../edits.hpp"
+#include "./events.hpp"
+#include "./sax.hpp"
+#include "./select.hpp"
+#include "./intern.hpp"
+#include "./ct.hpp"
+#include "./format.hpp"
+#include "./schema.hpp"
+#include "./lazy.hpp"
+
+#include <cstdlib>
+#include <optional>
+#include <thread>
+#include <limits>
 
 using namespace parsec;
 
@@ -82,6 +97,61 @@ SCENARIO("Number") {
             REQUIRE ( is_success(number("-0.124E-24")) );
         }
     }
+
+    GIVEN("The literal a match was made of") {
+        json::numeric n;
+        THEN("number_literal converts it in the same pass") {
+            REQUIRE( json::number_literal("-12.5e1,", n) == 7 );
+            REQUIRE( n.real() == -125.0 );
+            REQUIRE( json::number_literal("18446744073709551615", n) == 20 );
+            REQUIRE( n.uint64() == std::numeric_limits<std::uint64_t>::max() );
+            REQUIRE( json::number_literal("-x", n) == 0 );
+        }
+    }
+}
+
+SCENARIO("Number conversion") {
+    const auto scan = [](const std::string_view in) {
+        json::numeric n;
+        std::size_t pos = 0;
+        REQUIRE( json::scan::number(in, pos, n) );
+        REQUIRE( n.text == in );
+        return n;
+    };
+    using kind = json::numeric::kind;
+
+    GIVEN("Integers") {
+        REQUIRE( scan("0").type() == kind::int64 );
+        REQUIRE( scan("-0").int64() == 0 );
+        REQUIRE( scan("12345678").int64() == 12345678 );
+        REQUIRE( scan("-1234567890123456789").int64() == -1234567890123456789 );
+        REQUIRE( scan("9223372036854775807").int64() == std::numeric_limits<std::int64_t>::max() );
+        REQUIRE( scan("-9223372036854775808").int64() == std::numeric_limits<std::int64_t>::min() );
+
+        REQUIRE( scan("9223372036854775808").type() == kind::uint64 );
+        REQUIRE( scan("18446744073709551615").type() == kind::uint64 );
+        REQUIRE( scan("18446744073709551615").uint64() == std::numeric_limits<std::uint64_t>::max() );
+    }
+
+    GIVEN("Integers that do not fit in 64 bits") {
+        REQUIRE( scan("18446744073709551616").type() == kind::big );
+        REQUIRE( scan("-9223372036854775809").type() == kind::big );
+        REQUIRE( scan("123456789012345678901234567890").text == "123456789012345678901234567890" );
+        REQUIRE( scan("123456789012345678901234567890").real() == 123456789012345678901234567890.0 );
+    }
+
+    GIVEN("Reals") {
+        for (const auto literal : {
+            "0.1", "-0.5", "1e23", "1.5e-3", "3.141592653589793", "2.2250738585072014e-308",
+            "4.9e-324", "1.7976931348623157e308", "9007199254740993", "9007199254740993.0",
+            "0.000000000000000000000000000001234", "12345678901234567890123.456e-10",
+            "123456781234567812345678", "1e400", "-1e-400", "0e99999999999"
+        }) {
+            REQUIRE( scan(literal).real() == std::strtod(literal, nullptr) );
+        }
+        REQUIRE( scan("1.0").type() == kind::float64 );
+        REQUIRE( scan("1e2").type() == kind::float64 );
+    }
 }
 
 SCENARIO("String") {
@@ -139,6 +209,57 @@ SCENARIO("String") {
 }
 
 
+SCENARIO("String decoding") {
+    std::string scratch;
+    const auto decode = [&scratch](const std::string_view in) -> std::optional<std::string_view> {
+        std::size_t pos = 0;
+        std::string_view contents;
+        if (!json::scan::string(in, pos, contents, scratch)) return std::nullopt;
+        return contents;
+    };
+
+    GIVEN("No escapes") {
+        const std::string in = "\"" + std::string(100, 'x') + "\" trailing";
+        const auto contents = decode(in);
+        THEN("the contents are a view of the input") {
+            REQUIRE( contents == std::string(100, 'x') );
+            REQUIRE( contents->data() == in.data() + 1 );
+        }
+    }
+
+    GIVEN("Escapes") {
+        REQUIRE( decode("\"a\\\"b\\\\c\\/d\\b\\f\\n\\r\\t\"") == "a\"b\\c/d\b\f\n\r\t" );
+        REQUIRE( decode("\"\\u0041\\u00e9\\u20AC\"") == "A\xC3\xA9\xE2\x82\xAC" );
+        REQUIRE( decode("\"\\uD83D\\uDE00\"") == "\xF0\x9F\x98\x80" );
+        REQUIRE( decode("\"\\udead\"") == "\xEF\xBF\xBD" );
+        REQUIRE( decode("\"\\uD83Dx\"") == "\xEF\xBF\xBDx" );
+        REQUIRE( decode("\"\\u12\"") == std::nullopt );
+        REQUIRE( decode("\"\\x\"") == std::nullopt );
+    }
+
+    GIVEN("Escapes at every offset of a block") {
+        for (std::size_t n = 0; n < 40; ++n) {
+            const std::string plain(n, 'p');
+            REQUIRE( decode("\"" + plain + "\\n" + plain + "\"") == plain + "\n" + plain );
+        }
+    }
+
+    GIVEN("UTF-8") {
+        REQUIRE( decode("\"gr\xC3\xBC\xC3\x9F \xE2\x82\xAC \xF0\x9F\x98\x80\"") == "gr\xC3\xBC\xC3\x9F \xE2\x82\xAC \xF0\x9F\x98\x80" );
+        REQUIRE( decode("\"\xC3\"") == std::nullopt );         // truncated
+        REQUIRE( decode("\"\xC0\xAF\"") == std::nullopt );     // overlong
+        REQUIRE( decode("\"\xED\xA0\x80\"") == std::nullopt ); // surrogate
+        REQUIRE( decode("\"\xF4\x90\x80\x80\"") == std::nullopt ); // past U+10FFFF
+        REQUIRE( decode("\"\xFF\"") == std::nullopt );
+    }
+
+    GIVEN("Control characters") {
+        REQUIRE( decode("\"a\nb\"") == std::nullopt );
+        REQUIRE( decode(std::string("\"a\0b\"", 5)) == std::nullopt );
+    }
+}
+
+
 TEST_CASE("whitespace") {
     REQUIRE( is_success(json::whitespace(" ")) );
     REQUIRE( is_success(json::whitespace("\t")) );
@@ -201,4 +322,702 @@ SCENARIO("Array") {
         REQUIRE( is_success(parse_json("[[[[]]]]")) );
         REQUIRE( is_success(parse_json("[[[[123]]]]")) );
     }
-}
\ No newline at end of file
+}
+
+SCENARIO("Events") {
+    const auto kinds = [](const std::string_view in) {
+        std::vector<json::event_kind> out;
+        for (const auto& e : json::events(in)) out.push_back(e.kind);
+        return out;
+    };
+    using enum json::event_kind;
+
+    GIVEN("A scalar") {
+        REQUIRE( kinds("-1.5e3") == std::vector { number } );
+        REQUIRE( kinds("\"a\\\"b\"") == std::vector { string } );
+    }
+
+    GIVEN("Nested containers") {
+        REQUIRE( kinds("{ \"a\": [1, {}, []], \"b\" : \"c\" }") == std::vector {
+            object_begin,
+                key, array_begin, number, object_begin, object_end, array_begin, array_end, array_end,
+                key, string,
+            object_end
+        } );
+        REQUIRE( kinds("[[[[123]]]]") == std::vector {
+            array_begin, array_begin, array_begin, array_begin, number,
+            array_end, array_end, array_end, array_end
+        } );
+    }
+
+    GIVEN("Event text") {
+        std::vector<std::string_view> texts;
+        for (const auto& e : json::events("{\"key\": 1337}")) texts.push_back(e.text);
+        REQUIRE( texts == std::vector<std::string_view> { "", "key", "1337", "" } );
+    }
+
+    GIVEN("Invalid input") {
+        REQUIRE( kinds("[1,]").back() == error );
+        REQUIRE( kinds("{\"a\" 1}").back() == error );
+        REQUIRE( kinds("{\"a\": 1,}").back() == error );
+        REQUIRE( kinds("[1 2]").back() == error );
+        REQUIRE( kinds("[").back() == error );
+    }
+
+    GIVEN("The same documents as json::parser()") {
+        for (const auto doc : {
+            "{}", "{ }", "{\t\r\n}", "{ \"foo\" : 1}", "{ \"foo\": {\"bar\": \"foobar\"}}",
+            "[]", "[\t\n]", "[1.23e-1]", "[{\"key\": \"value\"}]", "[1,]", "{,}", "-", "{\"a\":}"
+        }) {
+            REQUIRE( (kinds(doc).back() != error) == is_success(parse_json(doc)) );
+        }
+    }
+
+    WHEN("The consumer stops early") {
+        std::string_view id;
+        for (const auto& e : json::events("{\"id\": 42, \"rest\": [1, 2, this is never looked at")) {
+            if (e.kind == number) { id = e.text; break; }
+        }
+        REQUIRE( id == "42" );
+    }
+}
+
+
+SCENARIO("SAX") {
+    struct recorder : json::sax::handler {
+        std::string trace;
+
+        void on_object_begin() { trace += '{'; }
+        void on_object_end() { trace += '}'; }
+        void on_array_begin() { trace += '['; }
+        void on_array_end() { trace += ']'; }
+        void on_key(std::string_view key) { trace.append("k:").append(key).append(" "); }
+        void on_string(std::string_view s) { trace.append("s:").append(s).append(" "); }
+        void on_number(const json::numeric& n) { trace.append("n:").append(n.text).append(" "); }
+    };
+
+    GIVEN("A document") {
+        recorder r;
+        const auto status = json::sax::parse("{\"a\": [1, -2.5e3], \"b\": {\"c\": \"d\"}} trailing", r);
+
+        REQUIRE( status );
+        REQUIRE( status.offset == 35 );
+        REQUIRE( r.trace == "{k:a [n:1 n:-2.5e3 ]k:b {k:c s:d }}" );
+    }
+
+    GIVEN("The no-op handler") {
+        THEN("it validates like json::parser()") {
+            for (const auto doc : {
+                "{}", "{\t\r\n}", "{ \"foo\" : 1}", "[[[[123]]]]", "\"\\u12\"", "[1,]", "{,}", "{\"a\" 1}", "-0."
+            }) {
+                REQUIRE( bool(json::sax::parse(doc)) == is_success(parse_json(doc)) );
+            }
+        }
+
+        THEN("failures report where they stopped") {
+            const auto status = json::sax::parse("[1, 2,, 3]");
+            REQUIRE( !status );
+            REQUIRE( status.offset == 6 );
+        }
+
+        THEN("nesting deeper than the limit is an error, not a stack overflow") {
+            REQUIRE( json::sax::parse(std::string(512, '[') + std::string(512, ']')) );
+
+            const auto status = json::sax::parse(std::string(513, '[') + std::string(513, ']'));
+            REQUIRE( !status );
+            REQUIRE( status.offset == 512 );
+            REQUIRE( !json::sax::parse(std::string(1'000'000, '[')) );
+        }
+    }
+}
+
+
+SCENARIO("Selecting JSON pointers") {
+    struct collector : json::sax::handler {
+        std::vector<std::pair<std::size_t, std::string>> found;
+
+        void on_path(std::size_t index) { found.emplace_back(index, ""); }
+        void on_key(std::string_view key) { found.back().second.append(key).append(":"); }
+        void on_string(std::string_view s) { found.back().second.append(s).append(" "); }
+        void on_number(const json::numeric& n) { found.back().second.append(n.text).append(" "); }
+    };
+
+    const std::string doc =
+        "{\"skip\": {\"deep\": [1, \"}]\\\"\", {}]}, "
+        "\"user\": {\"id\": 7, \"name\": \"ann\", \"tags\": [\"a\", \"b\"]}, "
+        "\"a/b\": 1, \"m~n\": 2}";
+
+    GIVEN("Pointers into objects and arrays") {
+        collector c;
+        const json::pointer_set paths({ "/user/id", "/user/tags/1", "/a~1b", "/m~0n" });
+        const auto status = json::sax::select(doc, paths, c);
+
+        REQUIRE( status );
+        REQUIRE( status.offset == doc.size() );
+        REQUIRE( c.found == std::vector<std::pair<std::size_t, std::string>> {
+            { 0, "7 " }, { 1, "b " }, { 2, "1 " }, { 3, "2 " }
+        } );
+    }
+
+    GIVEN("Array indexes") {
+        collector c;
+        const json::pointer_set paths({ "/user/tags/0", "/user/tags/01", "/user/tags/-", "/user/tags/1" });
+        REQUIRE( json::sax::select(doc, paths, c) );
+        REQUIRE( c.found == std::vector<std::pair<std::size_t, std::string>> { { 0, "a " }, { 3, "b " } } );
+    }
+
+    GIVEN("Pointers that aren't valid") {
+        const json::pointer_set paths({ "/user/id", "/a~2b", "user", "/c~" });
+        REQUIRE( paths.rejected() == std::vector<std::size_t> { 1, 2, 3 } );
+        REQUIRE( !json::sax::select(doc, paths) );
+    }
+
+    GIVEN("A pointer to a whole subtree") {
+        collector c;
+        REQUIRE( json::sax::select(doc, json::pointer_set({ "/user" }), c) );
+        REQUIRE( c.found.size() == 1 );
+        REQUIRE( c.found[0].second == "id:7 name:ann tags:a b " );
+    }
+
+    GIVEN("The empty pointer") {
+        collector c;
+        REQUIRE( json::sax::select("[1, 2]", json::pointer_set({ "" }), c) );
+        REQUIRE( c.found[0].second == "1 2 " );
+    }
+
+    GIVEN("Escapes and brackets inside strings around block boundaries") {
+        for (std::size_t n = 0; n < 140; ++n) {
+            const std::string skipped = "[\"" + std::string(n, 'a') + "\\\\\\\"]}\", {\"k\": [\"\\\\\"]}]";
+            std::size_t pos = 0;
+            REQUIRE( json::scan::skip_value(skipped + ", 1", pos) );
+            REQUIRE( pos == skipped.size() );
+            REQUIRE( json::sax::parse(skipped).offset == skipped.size() );
+        }
+    }
+
+    GIVEN("Unselected values") {
+        THEN("they are skipped without being validated") {
+            REQUIRE( json::sax::select("{\"x\": [1, 2 3 ?], \"y\": 1}", json::pointer_set({ "/y" })) );
+        }
+
+        THEN("selected values are validated") {
+            REQUIRE( !json::sax::select("{\"x\": [1, 2], \"y\": [1,]}", json::pointer_set({ "/y" })) );
+        }
+    }
+}
+
+
+SCENARIO("Optimized grammar") {
+    const auto reference = json::parser(false);
+    const auto optimized = json::parser();
+
+    const std::vector<std::string> corpus {
+        "{\"a\": [1, -2.5e3, {}, []], \"b\" : {\"c\": \"d\\n\"}}",
+        "[ 0.5 , \"x\" ,[ ] , { \"k\" :\t-0 } ]",
+        "[1 2]",
+        "{\"a\":1e+7}",
+    };
+
+    THEN("it agrees with the reference on every single-character edit of the corpus") {
+        edits::check(corpus, " ,:[]{}\"-.e1", [&](const std::string& edit) {
+            const auto expected = reference(edit);
+            const auto actual = optimized(edit);
+            if (expected.index() != actual.index()) return false;
+            if (is_success(expected) && std::get<Success>(expected) != std::get<Success>(actual)) return false;
+
+            const auto length = is_success(expected) ? parsec::Match(edit.size() - std::get<1>(std::get<Success>(expected)).size()) : std::nullopt;
+            return reference.recognize(edit) == length && optimized.recognize(edit) == length;
+        });
+    }
+
+    THEN("its rules share their common parts, and every parser() is the same grammar") {
+        const auto shared = parsec::footprint(optimized);
+        REQUIRE( shared.nodes < parsec::footprint(reference).nodes );
+        REQUIRE( shared.nodes < shared.tree );
+        REQUIRE( json::parser().node == optimized.node );
+    }
+}
+
+// Checked by the compiler, there is nothing to run
+static_assert(json::ct::valid(R"({"a": [1, -2.5e3, {}, []], "b" : {"c": "d\n\u00e9"}})"));
+static_assert(json::ct::valid("0"));
+static_assert(!json::ct::valid("01"));
+static_assert(!json::ct::valid("[1,]"));
+static_assert(!json::ct::valid("{\"a\" 1}"));
+static_assert(!json::ct::valid(" [] "));
+static_assert(json::ct::literal<R"({"retries": [1, 2, 4]})">().size() == 22);
+
+SCENARIO("Compile-time grammar") {
+    THEN("it agrees with sax::parse on every single-character edit of the corpus") {
+        const std::vector<std::string> corpus {
+            "{\"a\": [1, -2.5e3, {}, []], \"b\" : {\"c\": \"d\\n\"}}",
+            "[ 0.5 , \"x\" ,[ ] , { \"k\" :\t-0 } ]",
+            "{\"a\":1e+7, \"\\u00e9\": \"\\\"\"}",
+        };
+        edits::check(corpus, " ,:[]{}\"-.e1\\u", [](const std::string& edit) {
+            const auto status = json::sax::parse(edit);
+            return json::ct::valid(edit) == (status && status.offset == edit.size());
+        });
+    }
+}
+
+std::string document(std::size_t size);
+
+SCENARIO("Incremental parsing") {
+    const auto p = json::parser();
+    const std::string base = "{\"a\": [1, -2.5e3, {}, []], \"b\" : {\"c\": \"d\\n\", \"e\": [[0], {\"f\": 12}]}}";
+
+    THEN("a sequence of edits gives what parsing each version from scratch does") {
+        parsec::Incremental doc(p, base);
+        const std::string replacements = " ,:[]{}\"-.e1";
+        std::size_t seed = 12345;
+        for (int step = 0; step < 2000; ++step) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            const auto offset = (seed >> 33) % (doc.text().size() + 1);
+            const auto removed = std::min<std::size_t>((seed >> 20) % 3, doc.text().size() - offset);
+            const auto inserted = (seed >> 40) % 4 ? std::string(1, replacements[(seed >> 45) % replacements.size()]) : std::string();
+            doc.edit(offset, removed, inserted);
+
+            const auto expected = p(doc.text());
+            REQUIRE( expected.index() == doc.result().index() );
+            if (is_success(expected)) REQUIRE( std::get<Success>(expected) == std::get<Success>(doc.result()) );
+
+            // Keep it from drifting into something unrecognizable
+            if (step % 50 == 49) doc.edit(0, doc.text().size(), base);
+        }
+    }
+
+    THEN("an edit deep inside reuses the rest") {
+        parsec::Incremental doc(p, document(200000));
+        const auto full = doc.stats().evaluated;
+        const auto at = doc.text().find("\"id\": 1234,");
+        REQUIRE( at != std::string::npos );
+
+        doc.edit(at + 7, 1, "9");
+        REQUIRE( is_success(doc.result()) );
+        REQUIRE( doc.stats().evaluated * 100 < full );
+    }
+}
+
+// Runs the formatter over `in` fed `chunk` bytes at a time, through an
+// output buffer of `buffer` bytes
+std::optional<std::string> reformat(const std::string_view in, const int indent = -1, const std::size_t chunk = 4096, const std::size_t buffer = 64) {
+    std::string out;
+    std::vector<char> space(buffer);
+    json::formatter format(space, [&out](const std::string_view text) { out += text; }, indent);
+    for (std::size_t at = 0; at < in.size(); at += chunk) format.feed(in.substr(at, chunk));
+    if (!format.finish()) return std::nullopt;
+    return out;
+}
+
+SCENARIO("Formatting") {
+    const std::string doc = " {\"a\" : [1, -2.5e3, {}, [ ]], \"b\":{\"c\": \"d\\n\\u00e9 \u00e9\", \"e\": [[0], {\"f\": 12}]}}\n";
+
+    THEN("it minifies") {
+        REQUIRE( reformat(doc) == R"({"a":[1,-2.5e3,{},[]],"b":{"c":"d\n\u00e9 é","e":[[0],{"f":12}]}})" );
+        REQUIRE( reformat("  12 ") == "12" );
+    }
+
+    THEN("it pretty prints") {
+        REQUIRE( reformat("{\"a\":[1,{}],\"b\":{\"c\":\"d\"}}", 2) == "{\n  \"a\": [\n    1,\n    {}\n  ],\n  \"b\": {\n    \"c\": \"d\"\n  }\n}\n" );
+        REQUIRE( reformat(*reformat(doc, 4)) == reformat(doc) );
+    }
+
+    THEN("chunk and buffer sizes don't change the output") {
+        for (const std::size_t chunk : { 1, 2, 3, 7, 64 }) {
+            for (const std::size_t buffer : { 1, 5, 4096 }) {
+                REQUIRE( reformat(doc, -1, chunk, buffer) == reformat(doc) );
+                REQUIRE( reformat(doc, 3, chunk, buffer) == reformat(doc, 3) );
+            }
+        }
+    }
+
+    THEN("errors have an offset") {
+        std::vector<char> space(16);
+        json::formatter format(space, [](std::string_view) {});
+        REQUIRE( format.feed("[1, 2") );
+        REQUIRE( !format.feed(",]") );
+        REQUIRE( format.status().offset == 6 );
+        REQUIRE( !format.finish() );
+    }
+
+    THEN("it accepts what sax::parse accepts, one byte at a time") {
+        const std::vector<std::string> corpus {
+            "{\"a\": [1, -2.5e3, {}, []], \"b\" : {\"c\": \"d\\n\"}}",
+            "[ 0.5 , \"x\\u12aB\" ,[ ] , { \"k\" :\t-0 } ]",
+            "[\"\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80\", 1e+7, 0.25E-2]",
+        };
+        edits::check(corpus, " ,:[]{}\"-.e1\\u0\xc3\xa9", [&](const std::string& edit) {
+            const auto value = std::string_view(edit).substr(json::scan::whitespace(edit, 0));
+            const auto status = json::sax::parse(value);
+            const bool valid = status && json::scan::whitespace(value, status.offset) == value.size();
+            return reformat(edit, -1, 1).has_value() == valid;
+        });
+    }
+}
+
+SCENARIO("Interned keys") {
+    GIVEN("A pool") {
+        json::key_pool keys;
+
+        THEN("every distinct key gets one id") {
+            const auto a = keys.intern("alpha");
+            const auto b = keys.intern("beta");
+            REQUIRE( a != b );
+            REQUIRE( keys.intern("alpha") == a );
+            REQUIRE( keys.name(b) == "beta" );
+
+            const auto stats = keys.statistics();
+            REQUIRE( stats.lookups == 3 );
+            REQUIRE( stats.hits == 1 );
+            REQUIRE( stats.keys == 2 );
+            REQUIRE( stats.bytes_saved() == 5 );
+        }
+
+        THEN("handlers can take ids instead of strings") {
+            struct ids : json::sax::handler {
+                std::vector<json::key_id> seen;
+                void on_key_id(json::key_id id) { seen.push_back(id); }
+            };
+
+            ids first;
+            ids second;
+            REQUIRE( json::sax::parse("{\"a\": {\"b\": 1, \"a\": 2}}", keys, first) );
+            REQUIRE( json::sax::parse("[{\"b\": 1}, {\"c\\u0061\": 2}]", keys, second) );
+            REQUIRE( first.seen == std::vector<json::key_id> { 0, 1, 0 } );
+            REQUIRE( second.seen == std::vector<json::key_id> { 1, 2 } );
+            REQUIRE( keys.name(2) == "ca" );
+        }
+
+        THEN("many threads agree on the ids") {
+            std::vector<std::vector<json::key_id>> results(4);
+            std::vector<std::thread> threads;
+            for (auto& result : results) {
+                threads.emplace_back([&keys, &result] {
+                    for (int i = 0; i < 2000; ++i) result.push_back(keys.intern("key" + std::to_string(i % 500)));
+                });
+            }
+            for (auto& thread : threads) thread.join();
+
+            REQUIRE( keys.size() == 500 );
+            for (const auto& result : results) {
+                for (std::size_t i = 0; i < result.size(); ++i) {
+                    REQUIRE( keys.name(result[i]) == "key" + std::to_string(i % 500) );
+                }
+            }
+        }
+    }
+
+    GIVEN("A full pool") {
+        json::key_pool keys(1);
+        REQUIRE( keys.intern("a") == 0 );
+        REQUIRE( keys.intern("b") == json::key_pool::none );
+        REQUIRE( keys.intern("a") == 0 );
+        REQUIRE( keys.intern("c") == json::key_pool::none );
+
+        const auto stats = keys.statistics();
+        REQUIRE( stats.lookups == 4 );
+        REQUIRE( stats.hits == 1 );
+    }
+
+    GIVEN("Keys hashed while they are scanned") {
+        std::string scratch;
+        for (std::size_t length = 0; length < 40; ++length) {
+            const auto plain = std::string(length, 'k');
+            for (const auto& literal : { "\"" + plain + "\": 1", "\"" + plain + "\\u0041\"", "\"\u00e9" + plain + "\"" }) {
+                std::size_t pos = 0;
+                std::string_view key;
+                std::uint64_t hash = 0;
+                REQUIRE( json::scan_key(literal, pos, key, scratch, hash) );
+                REQUIRE( hash == json::hash_key(key) );
+                REQUIRE( literal[pos - 1] == '"' );
+            }
+        }
+
+        std::size_t pos = 0;
+        std::string_view key;
+        std::uint64_t hash = 0;
+        REQUIRE_FALSE( json::scan_key("\"unterminated key", pos, key, scratch, hash) );
+    }
+}
+
+SCENARIO("Batches") {
+    GIVEN("Small documents") {
+        const auto p = json::parser();
+        const std::vector<std::string_view> documents {
+            R"({"id": 1, "tags": ["a", "b"]})",
+            R"([1.5e3, {"x": "\u00e9"}])",
+            R"({"id": 1, "name": "x\qy"})",
+            R"({"id": 01})",
+            R"({"id": 2} trailing)",
+        };
+
+        THEN("each one gets a status, a length and an error offset") {
+            const auto batch = parsec::parse_batch(documents, p);
+            REQUIRE( batch.size() == documents.size() );
+            REQUIRE( batch.status[0] == parsec::Batch::Status::ok );
+            REQUIRE( batch.consumed[0] == documents[0].size() );
+            REQUIRE( batch.status[1] == parsec::Batch::Status::ok );
+            REQUIRE( batch.consumed[1] == documents[1].size() );
+            REQUIRE( batch.status[2] == parsec::Batch::Status::failed );
+            REQUIRE( batch.errorOffset[2] == 18 );
+            REQUIRE( batch.status[3] == parsec::Batch::Status::failed );
+            REQUIRE( batch.errorOffset[3] == 8 );
+            REQUIRE( batch.status[4] == parsec::Batch::Status::ok );
+            REQUIRE( batch.consumed[4] == 9 );
+        }
+
+        THEN("it agrees with calling the parser") {
+            const auto batch = parsec::parse_batch(documents, p);
+            for (std::size_t i = 0; i < documents.size(); ++i) {
+                const auto res = p(documents[i]);
+                REQUIRE( std::holds_alternative<parsec::Success>(res) == (batch.status[i] == parsec::Batch::Status::ok) );
+            }
+        }
+    }
+}
+
+namespace records {
+    struct address {
+        std::string city;
+        std::optional<std::string> zip;
+    };
+
+    struct user {
+        std::int64_t id = 0;
+        std::string name;
+        double score = 0;
+        std::uint8_t level = 0;
+        std::vector<std::string> tags;
+        address home;
+        std::optional<std::vector<address>> previous;
+    };
+
+    struct tree {
+        std::vector<tree> children;
+    };
+}
+
+template <> struct json::schema<records::address> {
+    static constexpr auto fields = json::fields(
+        json::field("city", &records::address::city),
+        json::field("zip", &records::address::zip));
+};
+
+template <> struct json::schema<records::user> {
+    static constexpr auto fields = json::fields(
+        json::field("id", &records::user::id),
+        json::field("name", &records::user::name),
+        json::field("score", &records::user::score),
+        json::field("level", &records::user::level),
+        json::field("tags", &records::user::tags),
+        json::field("home", &records::user::home),
+        json::field("previous", &records::user::previous));
+};
+
+template <> struct json::schema<records::tree> {
+    static constexpr auto fields = json::fields(json::field("children", &records::tree::children));
+};
+
+// The key table is built by the compiler
+static_assert(json::schema<records::user>::fields.keys.find("home") == 5);
+static_assert(json::schema<records::user>::fields.keys.find("homes") == 7);
+static_assert(json::schema<records::user>::fields.required == 0b0111111);
+
+SCENARIO("Reading into structs") {
+    GIVEN("a document with every field") {
+        const std::string doc = R"({"id": -42, "name": "Ada \"L\"", "score": 2.5e1, "level": 7, "tags": ["a", "b"],
+            "home": {"city": "London", "zip": "N1"}, "previous": [{"city": "Paris"}]})";
+        records::user u;
+        const auto status = json::read(doc, u);
+
+        THEN("the members are filled in") {
+            REQUIRE( status );
+            REQUIRE( status.offset == doc.size() );
+            REQUIRE( u.id == -42 );
+            REQUIRE( u.name == "Ada \"L\"" );
+            REQUIRE( u.score == 25.0 );
+            REQUIRE( u.level == 7 );
+            REQUIRE( u.tags == std::vector<std::string> { "a", "b" } );
+            REQUIRE( u.home.city == "London" );
+            REQUIRE( u.home.zip == "N1" );
+            REQUIRE( u.previous );
+            REQUIRE( u.previous->size() == 1 );
+            REQUIRE( (*u.previous)[0].city == "Paris" );
+            REQUIRE( !(*u.previous)[0].zip );
+        }
+    }
+
+    GIVEN("fields the schema doesn't know and escaped keys") {
+        const std::string doc = R"({"extra": {"deep": [1, {"x": "}"}]}, "\u0069d": 1, "name": "x", "score": 0, "level": 0,
+            "tags": [], "home": {"city": "c", "unknown": "\"]"}, "more": 5})";
+        records::user u;
+        REQUIRE( json::read(doc, u) );
+        REQUIRE( u.id == 1 );
+        REQUIRE( u.home.city == "c" );
+        REQUIRE( !u.previous );
+    }
+
+    GIVEN("a required field left out") {
+        records::user u;
+        const auto status = json::read(R"({"id": 1, "name": "x", "score": 0, "tags": [], "home": {"zip": "1"}})", u);
+        REQUIRE( !status );
+        REQUIRE( status.error == std::string("object: Missing a required field") );
+        REQUIRE( status.field == "city" );
+
+        const auto top = json::read(R"({"id": 1, "name": "x", "score": 0, "tags": [], "home": {"city": "1"}})", u);
+        REQUIRE( top.field == "level" );
+    }
+
+    GIVEN("values of the wrong type") {
+        records::user u;
+        const auto read = [&u](const std::string& level) {
+            return json::read(R"({"id": 1, "name": "x", "score": 0, "tags": [], "home": {"city": "1"}, "level": )" + level + "}", u);
+        };
+
+        REQUIRE( read("255") );
+        REQUIRE( read("256").error == std::string("number: Out of range") );
+        REQUIRE( read("-1").error == std::string("number: Out of range") );
+        REQUIRE( read("1.5").error == std::string("number: Expected an integer") );
+        REQUIRE( read("\"1\"").field == "level" );
+        REQUIRE( read("\"1\"").offset == 79 );
+        REQUIRE( json::read(R"({"id": 99999999999999999999})", u).error == std::string("number: Out of range") );
+        REQUIRE( json::read(R"({"id": 1 "name": "x"})", u).error == std::string("object: Expected ',' or '}'") );
+    }
+
+    GIVEN("the same struct read into twice") {
+        std::vector<records::address> all;
+        REQUIRE( json::read(R"([{"city": "a", "zip": "1"}, {"city": "b"}, {"city": "c"}])", all) );
+        REQUIRE( json::read(R"([{"city": "d"}, {"city": "e", "zip": "2"}])", all) );
+
+        THEN("nothing is left over from the first time") {
+            REQUIRE( all.size() == 2 );
+            REQUIRE( all[0].city == "d" );
+            REQUIRE( !all[0].zip );
+            REQUIRE( all[1].zip == "2" );
+        }
+    }
+
+    GIVEN("an array of records") {
+        std::vector<records::address> all;
+        REQUIRE( json::read(R"([{"city": "a"}, {"zip": "2", "city": "b"}])", all) );
+        REQUIRE( all.size() == 2 );
+        REQUIRE( all[1].city == "b" );
+        REQUIRE( all[1].zip == "2" );
+    }
+
+    GIVEN("a struct that holds a vector of itself") {
+        const auto nested = [](const std::size_t levels) {
+            std::string doc;
+            for (std::size_t i = 0; i < levels; ++i) doc += "{\"children\": [";
+            for (std::size_t i = 0; i < levels; ++i) doc += "]}";
+            return doc;
+        };
+
+        records::tree t;
+        REQUIRE( json::read(nested(256), t) );
+        REQUIRE( t.children.size() == 1 );
+
+        THEN("nesting deeper than the limit is an error, not a stack overflow") {
+            const auto status = json::read(nested(257), t);
+            REQUIRE( !status );
+            REQUIRE( status.error == std::string("object: Nested too deeply") );
+            REQUIRE( !json::read(nested(100'000), t) );
+        }
+    }
+}
+
+SCENARIO("Lazy access") {
+    const std::string doc = R"( {"skipped": {"a": [1, "]}", {"b": "\""}]}, "user": {"name": "Ada\nL", "\u0069d": 42,
+        "scores": [1.5, -2, {"deep": "x"}]}, "empty": {}, "list": []} )";
+    const json::lazy root { doc };
+
+    THEN("values are found by key and index") {
+        REQUIRE( root.type() == json::lazy::kind::object );
+        REQUIRE( root["user"]["id"].int64() == 42 );
+        REQUIRE( root["user"]["name"].string() == "Ada\nL" );
+        REQUIRE( root["user"]["scores"][0].real() == 1.5 );
+        REQUIRE( root["user"]["scores"][1].int64() == -2 );
+        REQUIRE( root["user"]["scores"][2]["deep"].raw() == "\"x\"" );
+        REQUIRE( root["skipped"]["a"][1].string() == "]}" );
+        REQUIRE( root["user"]["scores"].raw() == R"([1.5, -2, {"deep": "x"}])" );
+    }
+
+    THEN("missing values are empty, and so is anything looked up in them") {
+        REQUIRE( !root["nobody"] );
+        REQUIRE( !root["nobody"]["id"] );
+        REQUIRE( !root["user"]["scores"][3] );
+        REQUIRE( !root["empty"]["x"] );
+        REQUIRE( !root["list"][0] );
+        REQUIRE( !root["user"][0] );
+        REQUIRE( !root["user"]["name"].int64() );
+        REQUIRE( !root["user"]["id"].string() );
+        REQUIRE( root["nobody"]["id"].error() == nullptr );
+    }
+
+    THEN("members and elements can be walked") {
+        std::vector<std::string> keys;
+        REQUIRE( root.members([&keys](const std::string_view key, const json::lazy&) { keys.emplace_back(key); return true; }) );
+        REQUIRE( keys == std::vector<std::string> { "skipped", "user", "empty", "list" } );
+
+        std::size_t count = 0;
+        REQUIRE( root["user"]["scores"].elements([&count](const json::lazy& v) { return v.type() == json::lazy::kind::number && ++count; }) == false );
+        REQUIRE( count == 2 );
+    }
+
+    THEN("broken input is reported where the walk ran into it") {
+        const json::lazy broken { R"({"a": 1 "b": 2})" };
+        REQUIRE( broken["a"].int64() == 1 );
+        REQUIRE( !broken["b"] );
+        REQUIRE( broken["b"].error() == std::string("container: Expected ',' or a closing bracket") );
+        REQUIRE( broken["b"]["c"].offset() == 8 );
+        REQUIRE( json::lazy { "  " }.error() );
+    }
+
+    THEN("leading whitespace is skipped") {
+        const json::lazy padded { " \n {\"a\": 1}" };
+        REQUIRE( padded["a"].int64() == 1 );
+        REQUIRE( padded.offset() == 3 );
+    }
+
+    THEN("it finds what select finds") {
+        const auto wide = document(1 << 12);
+        const json::lazy array { wide };
+        for (std::size_t i = 0; i < 20; ++i) {
+            const json::pointer_set paths({ "/" + std::to_string(i) + "/name" });
+            std::string selected;
+            struct : json::sax::handler {
+                std::string* out;
+                void on_string(const std::string_view s) { out->assign(s); }
+            } h;
+            h.out = &selected;
+            REQUIRE( json::sax::select(wide, paths, h) );
+            REQUIRE( array[i]["name"].string() == selected );
+        }
+    }
+}
+
+// An array of small records, at least `size` bytes long
+std::string document(const std::size_t size) {
+    std::string doc = "[";
+    for (std::size_t i = 0; doc.size() < size; ++i) {
+        if (i) doc += ", ";
+        doc += "{\"id\": " + std::to_string(i) + ", \"name\": \"item number " + std::to_string(i)
+            + "\", \"tags\": [\"a\", \"b\"], \"score\": -1.5e3}";
+    }
+    return doc + "]";
+}
+
+TEST_CASE("allocations") {
+    const auto doc = document(1 << 20);
+
+    SECTION("json::parser() on 1 MB") {
+        const auto counts = alloc::measure([&] { REQUIRE( is_success(parse_json(doc)) ); });
+        // 424,063 at the time of writing; lower it when it improves
+        REQUIRE( counts.allocations <= 440000 );
+    }
+
+    SECTION("sax::parse on 1 MB") {
+        REQUIRE( alloc::allocations([&] { REQUIRE( json::sax::parse(doc) ); }) == 0 );
+    }
+}
@@ -0,0 +1,56 @@
+#include "../parsec.hpp"
+#include "../bench.hpp"
+#include "./msgpack.hpp"
+#include "./encode.hpp"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+void stream() {
+    std::string records;
+    for (std::size_t i = 0; records.size() < (4 << 20); ++i) msgpack::encode::record(records, i);
+    const auto all = parsec::seq::some(msgpack::parser());
+
+    bench::report("msgpack::parser() stream", bench::time([&] { bench::keep(all(records)); }), records.size());
+    bench::report("msgpack::parser() stream, recognize", bench::time([&] { bench::keep(all.recognize(records)); }), records.size());
+}
+
+// The primitives on their own: a u32 count of length-prefixed frames
+void frames() {
+    std::string frames;
+    const std::size_t count = 100000;
+    for (int i = 3; i >= 0; --i) frames.push_back(static_cast<char>(count >> (8 * i)));
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t n = 16 + i % 48;
+        // varint length, then the payload
+        while (n >= 0x80) {
+            frames.push_back(static_cast<char>(n | 0x80));
+            n >>= 7;
+        }
+        frames.push_back(static_cast<char>(n));
+        frames.append(16 + i % 48, 'x');
+    }
+
+    using namespace parsec;
+    const auto p = binary::count(binary::u32be(), binary::prefixed(binary::varint()));
+    bench::report("count(u32be, prefixed(varint))", bench::time([&] { bench::keep(p(frames)); }), frames.size());
+    bench::report("count(u32be, prefixed(varint)), recognize", bench::time([&] { bench::keep(p.recognize(frames)); }), frames.size());
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::pair<std::string_view, std::function<void()>>> benchmarks {
+        { "stream", stream },
+        { "frames", frames },
+    };
+
+    for (const auto& [name, run] : benchmarks) {
+        if (argc > 1 && name != argv[1]) continue;
+        std::printf("# %.*s\n", int(name.size()), name.data());
+        run();
+    }
+
+    return 0;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Just enough of an encoder to make test and benchmark input
+namespace msgpack::encode {
+
+void big_endian(std::string& out, const std::uint64_t value, const int bytes) {
+    for (int i = bytes - 1; i >= 0; --i) out.push_back(static_cast<char>(value >> (8 * i)));
+}
+
+void uint(std::string& out, const std::uint64_t value) {
+    if (value < 0x80) {
+        out.push_back(static_cast<char>(value));
+        return;
+    }
+
+    const int bytes = value <= 0xff ? 1 : value <= 0xffff ? 2 : value <= 0xffffffff ? 4 : 8;
+    out.push_back(static_cast<char>(bytes == 1 ? 0xcc : bytes == 2 ? 0xcd : bytes == 4 ? 0xce : 0xcf));
+    big_endian(out, value, bytes);
+}
+
+void str(std::string& out, const std::string_view s) {
+    if (s.size() < 32) {
+        out.push_back(static_cast<char>(0xa0 | s.size()));
+    } else if (s.size() <= 0xff) {
+        out.push_back('\xd9');
+        big_endian(out, s.size(), 1);
+    } else {
+        out.push_back('\xda');
+        big_endian(out, s.size(), 2);
+    }
+    out += s;
+}
+
+void bin(std::string& out, const std::string_view b) {
+    out.push_back('\xc4');
+    big_endian(out, b.size(), 1);
+    out += b;
+}
+
+void float64(std::string& out, const double d) {
+    out.push_back('\xcb');
+    big_endian(out, std::bit_cast<std::uint64_t>(d), 8);
+}
+
+// The header of an array or map with `n` entries
+void array(std::string& out, const std::size_t n) {
+    if (n < 16) {
+        out.push_back(static_cast<char>(0x90 | n));
+    } else {
+        out.push_back('\xdc');
+        big_endian(out, n, 2);
+    }
+}
+
+void map(std::string& out, const std::size_t n) {
+    if (n < 16) {
+        out.push_back(static_cast<char>(0x80 | n));
+    } else {
+        out.push_back('\xde');
+        big_endian(out, n, 2);
+    }
+}
+
+// A record like an RPC payload would have, `i` varies the sizes
+void record(std::string& out, const std::size_t i) {
+    map(out, 6);
+    str(out, "id");
+    uint(out, 100000 + i * 7919);
+    str(out, "name");
+    str(out, "user name number " + std::to_string(i) + std::string(i % 40, 'x'));
+    str(out, "tags");
+    array(out, i % 5);
+    for (std::size_t t = 0; t < i % 5; ++t) str(out, "tag" + std::to_string(t));
+    str(out, "blob");
+    bin(out, std::string(i % 64, '\x01'));
+    str(out, "score");
+    float64(out, i * 0.25);
+    str(out, "ok");
+    out.push_back(i % 2 ? '\xc3' : '\xc2');
+}
+
+} // namespace msgpack::encode
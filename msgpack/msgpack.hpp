@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "../parsec.hpp"
+#include "../parsec_binary.hpp"
+
+namespace msgpack {
+
+// One MessagePack value, with everything the spec has except ext types.
+// Lengths come from the tag byte (fixstr, fixarray, fixmap) or from the
+// field after it, and go through binary::prefixed and binary::count.
+parsec::Parser parser() {
+    using namespace parsec;
+    using binary::Integer;
+
+    const auto tags = [](const std::uint8_t low, const std::uint8_t high) {
+        return match::ch_fn([low, high](const char c) {
+            const auto tag = static_cast<std::uint8_t>(c);
+            return tag >= low && tag <= high;
+        });
+    };
+    const auto low4 = [](const std::string_view tag) -> std::uint64_t { return tag[0] & 0x0f; };
+    const auto low5 = [](const std::string_view tag) -> std::uint64_t { return tag[0] & 0x1f; };
+    const auto tag = [](const unsigned char c) { return match::ch(static_cast<char>(c)); };
+    const auto after = [&tag](const unsigned char c, const Parser& p) { return seq::andThen({ tag(c), p }); };
+
+    // Arrays and maps hold values, the rule refers to itself through the
+    // holder (same as the rules in json::parser())
+    const auto holder = std::make_shared<Parser>();
+    const Parser value = Node { Node::Kind::fn, [rule = holder.get()](const std::string_view in) { return (*rule)(in); }, {}, {},
+                                [rule = holder.get()](const std::string_view in) { return rule->recognize(in); } };
+    const auto pair = seq::andThen({ value, value });
+
+    *holder = match::oneOf({
+        // positive and negative fixint, nil, false, true
+        tags(0x00, 0x7f),
+        tags(0xe0, 0xff),
+        match::set("\xc0\xc2\xc3"),
+        binary::prefixed(Integer(tags(0xa0, 0xbf), low5)),
+        binary::count(Integer(tags(0x90, 0x9f), low4), value),
+        binary::count(Integer(tags(0x80, 0x8f), low4), pair),
+        // uint 8-64, int 8-64, float 32/64
+        after(0xcc, binary::bytes(1)),
+        after(0xcd, binary::bytes(2)),
+        after(0xce, binary::bytes(4)),
+        after(0xcf, binary::bytes(8)),
+        after(0xd0, binary::bytes(1)),
+        after(0xd1, binary::bytes(2)),
+        after(0xd2, binary::bytes(4)),
+        after(0xd3, binary::bytes(8)),
+        after(0xca, binary::bytes(4)),
+        after(0xcb, binary::bytes(8)),
+        // str and bin 8-32
+        after(0xd9, binary::prefixed(binary::u8())),
+        after(0xda, binary::prefixed(binary::u16be())),
+        after(0xdb, binary::prefixed(binary::u32be())),
+        after(0xc4, binary::prefixed(binary::u8())),
+        after(0xc5, binary::prefixed(binary::u16be())),
+        after(0xc6, binary::prefixed(binary::u32be())),
+        // array and map 16/32
+        after(0xdc, binary::count(binary::u16be(), value)),
+        after(0xdd, binary::count(binary::u32be(), value)),
+        after(0xde, binary::count(binary::u16be(), pair)),
+        after(0xdf, binary::count(binary::u32be(), pair)),
+    });
+
+    return Node { Node::Kind::fn, [holder](const std::string_view in) { return (*holder)(in); }, {}, {},
+                  [holder](const std::string_view in) { return holder->recognize(in); } };
+}
+
+} // namespace msgpack
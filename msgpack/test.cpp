@@ -0,0 +1,67 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../parsec.hpp"
+#include "./msgpack.hpp"
+#include "./encode.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace parsec;
+
+// How much of `in` the grammar matched, checking that both ways of running
+// it agree
+Match matched(const Parser& p, const std::string& in) {
+    const auto res = p(in);
+    const auto length = std::holds_alternative<Success>(res) ? Match(in.size() - std::get<1>(std::get<Success>(res)).size()) : std::nullopt;
+    REQUIRE( p.recognize(in) == length );
+    if (length) REQUIRE( std::get<0>(std::get<Success>(res)) == in.substr(0, *length) );
+    return length;
+}
+
+SCENARIO("MessagePack") {
+    const auto p = msgpack::parser();
+
+    GIVEN("single values") {
+        const std::vector<std::string> values {
+            "\x05", "\xff", "\xc0", "\xc3", std::string("\xcc\x00", 2), "\xcd\x01\x02", "\xd3\x01\x02\x03\x04\x05\x06\x07\x08",
+            "\xa3" "abc", "\xd9\x02" "ab", std::string("\xda\x00\x01" "a", 4), std::string("\xc4\x00", 2),
+            "\x92\x01\xa1x", "\x81\xa1k\x90", std::string("\xdc\x00\x02\x01\x02", 5), std::string("\xde\x00\x01\x01\x02", 5),
+        };
+
+        THEN("each is matched whole, and no shorter piece of it is") {
+            for (const auto& value : values) {
+                REQUIRE( matched(p, value + "rest") == value.size() );
+                for (std::size_t n = 0; n < value.size(); ++n) REQUIRE( !matched(p, value.substr(0, n)) );
+            }
+        }
+    }
+
+    GIVEN("a stream of records") {
+        std::string stream;
+        for (std::size_t i = 0; i < 200; ++i) msgpack::encode::record(stream, i);
+        const auto all = seq::some(p);
+
+        THEN("it is matched whole") {
+            REQUIRE( matched(all, stream) == stream.size() );
+        }
+
+        THEN("cutting it short anywhere in a record leaves only the records before") {
+            std::vector<std::size_t> ends { 0 };
+            for (std::size_t i = 0; i < 3; ++i) {
+                std::string one;
+                msgpack::encode::record(one, i);
+                ends.push_back(ends.back() + one.size());
+            }
+            for (std::size_t n = 1; n < ends.back(); ++n) {
+                const auto complete = *std::prev(std::upper_bound(ends.begin(), ends.end(), n));
+                REQUIRE( matched(all, stream.substr(0, n)) == (complete ? Match(complete) : std::nullopt) );
+            }
+        }
+    }
+
+    GIVEN("a length that promises more than there is") {
+        REQUIRE( !matched(p, "\xdb\xff\xff\xff\xff" "abc") );
+        REQUIRE( !matched(p, "\xdd\xff\xff\xff\xff\x01") );
+    }
+}
@@ -2,25 +2,204 @@
 
 #include <variant>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <concepts>
 #include <vector>
 #include <iostream>
 #include <type_traits>
 #include <optional>
+#include <functional>
+#include <array>
+#include <memory>
+#include <algorithm>
+#include <map>
+#include <span>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <bit>
 
 
 namespace parsec {
 using namespace std;
 
 using Failure = string;
-using Success = pair<string, string>;
+// The matched text and a view of the input that is left; parsers only ever
+// look at a view, so the unconsumed input is never copied.
+using Success = pair<string, string_view>;
 
 using Result = variant<Success, Failure>;
 
-using Parser = function<Result(const string)>;
+// What a parser gives back when it only recognizes (see Parser::recognize):
+// the length of the match, or nothing if it failed.
+using Match = std::optional<size_t>;
+
 using Matcher = function<bool(const char in)>;
 
+class Parser;
+
+// What a parser is made of. Every combinator records its kind and operands
+// next to the function that runs it, so a grammar can be inspected
+// (describe) and rewritten (optimize). A parser made from any other callable
+// is an opaque `fn` node.
+struct Node {
+  enum class Kind {
+    fn, ch, ch_fn, alpha, str, oneOf, until, repeatedly,
+    andThen, some, any, xImplies, optional,
+    // What optimize() turns oneOf(ch...) and any(oneOf(ch...)) into
+    set, span,
+    memo,
+    // phrase()
+    lexeme, skip,
+    // parsec_binary.hpp
+    binary, prefixed, count,
+  };
+
+  Kind kind;
+  function<Result(string_view)> run;
+  vector<Parser> children {};
+  // ch/str: the literal, set/span: the member characters, binary: what it
+  // reads (u32be, varint, ...), count: the number of times if it is fixed,
+  // skip: the characters it skips
+  string text {};
+  // The same parser, returning only how much it matched. Left out for
+  // opaque parsers, which are then run and their match thrown away.
+  function<Match(string_view)> recognize {};
+};
+
+class Parser {
+public:
+  Parser() = default;
+  Parser(Node n) : node(make_shared<const Node>(std::move(n))) {}
+
+  template <typename F>
+    requires (!derived_from<decay_t<F>, Parser> && !same_as<decay_t<F>, Node> && is_invocable_r_v<Result, F, string_view>)
+  Parser(F f) : node(make_shared<const Node>(Node { Node::Kind::fn, std::move(f) })) {}
+
+  Result operator()(string_view input) const { return node->run(input); }
+
+  // Whether `input` starts with a match and how long it is, without
+  // building the matched text on the way: for validating, or when only the
+  // end of the match is needed.
+  Match recognize(string_view input) const {
+    if (node->recognize) return node->recognize(input);
+
+    const auto res = node->run(input);
+    if (const auto* success = get_if<Success>(&res)) return input.length() - get<1>(*success).length();
+    return nullopt;
+  }
+  explicit operator bool() const { return node != nullptr; }
+
+  shared_ptr<const Node> node;
+};
+
+
+// How many things on this thread read furthest/reached right now
+// (parse_batch, an Incremental while it parses, tests). failedAt() and
+// looked() only keep them up to date while there is one, so a plain parse
+// doesn't write them for every character.
+thread_local size_t tracking = 0;
+
+struct Tracked {
+  Tracked() { ++tracking; }
+  ~Tracked() { --tracking; }
+  Tracked(const Tracked&) = delete;
+  Tracked& operator=(const Tracked&) = delete;
+};
+
+// The furthest point in the input that a parser on this thread failed at.
+// Character level parsers push it forward whenever they fail, so after a
+// failed parse it is where the input stopped making sense (parse_batch
+// turns it into an error offset).
+thread_local const char* furthest = nullptr;
+
+void failedAt(const string_view input) {
+  if (tracking && less<const char*> {}(furthest, input.data())) furthest = input.data();
+}
+
+// The end of what parsers on this thread have looked at. Character level
+// parsers push it past every character they examine (matched or not), which
+// is how memo() knows the stretch of input a result depends on.
+thread_local const char* reached = nullptr;
+
+void looked(const string_view input, const size_t n) {
+  if (!tracking) return;
+  const auto end = input.data() + min(n, input.length());
+  if (less<const char*> {}(reached, end)) reached = end;
+}
+
+// Limits for one parse of untrusted input, see bounded(). A step is a call
+// to one of the combinators that can nest or loop (andThen, oneOf, some,
+// any, until, repeatedly) or a turn of one of their loops, and the depth is
+// how many of those calls are open at once.
+struct Budget {
+  size_t bytes = SIZE_MAX;
+  size_t depth = SIZE_MAX;
+  size_t steps = SIZE_MAX;
+  chrono::steady_clock::time_point deadline = chrono::steady_clock::time_point::max();
+  // Set it from any thread to stop the parse
+  const atomic<bool>* cancel = nullptr;
+};
+
+enum class Exceeded : uint8_t { none, bytes, depth, steps, deadline, cancelled };
+
+// The budget of the parse running on this thread. Steps are counted up to
+// `check`, where the limits that are slow to look at (the clock, the cancel
+// flag) are looked at again, so most steps cost an increment and a compare.
+// Once a limit is hit `check` drops to 0 and every combinator fails on entry.
+struct BudgetScope {
+  static constexpr size_t interval = 1024;
+
+  const Budget* budget = nullptr;
+  size_t steps = 0;
+  size_t check = SIZE_MAX;
+  size_t depth = 0;
+  size_t maxDepth = SIZE_MAX;
+  Exceeded exceeded = Exceeded::none;
+
+  bool over() {
+    if (exceeded == Exceeded::none && budget) {
+      if (depth > maxDepth) exceeded = Exceeded::depth;
+      else if (steps > budget->steps) exceeded = Exceeded::steps;
+      else if (budget->cancel && budget->cancel->load(memory_order_relaxed)) exceeded = Exceeded::cancelled;
+      else if (chrono::steady_clock::now() >= budget->deadline) exceeded = Exceeded::deadline;
+    }
+    if (exceeded != Exceeded::none) {
+      check = 0;
+      return true;
+    }
+    if (budget) check = min(min(budget->steps, SIZE_MAX - 1) + 1, steps + interval);
+    return false;
+  }
+};
+thread_local BudgetScope budgetScope;
+
+// Counts a step, true if that went over budget. Outside of bounded() there
+// is nothing to count.
+bool overBudget() {
+  auto& scope = budgetScope;
+  if (!scope.budget) return false;
+  return (++scope.steps >= scope.check || scope.depth > scope.maxDepth) && scope.over();
+}
+
+// What a combinator returns once the budget is gone; bounded() replaces it
+// with one that says which limit it was
+Failure outOfBudget() { return Failure { "budget: Exceeded" }; }
+
+// Holds a level of depth for as long as a combinator runs inside bounded()
+struct Nested {
+  Nested() : counted(budgetScope.budget != nullptr) { if (counted) ++budgetScope.depth; }
+  ~Nested() { if (counted) --budgetScope.depth; }
+  Nested(const Nested&) = delete;
+  Nested& operator=(const Nested&) = delete;
+
+  const bool counted;
+};
 
 std::ostream& operator<< (std::ostream &out, const parsec::Result &res) {
   if (holds_alternative<parsec::Failure>(res)) {
@@ -34,113 +213,295 @@ std::ostream& operator<< (std::ostream &out, const parsec::Result &res) {
 }
 
 Parser optional(const Parser p) {
-  return [p](const string input) -> Result {
-    const auto res = p(input);
+  return Node { Node::Kind::optional, [p](string_view input) -> Result {
+    auto res = p(input);
     if (std::holds_alternative<Failure>(res)) {
       return Success { "", input };
     }
     return res;
-  };
+  }, { p }, {}, [p](string_view input) -> Match {
+    return p.recognize(input).value_or(0);
+  } };
 };
 
 namespace match {
 
   Parser ch_fn(const Matcher m) {
-    return [m](const string input) -> Result {
-      if (input.length() == 0) return Failure { "ch_fn: No input" };
+    return Node { Node::Kind::ch_fn, [m](string_view input) -> Result {
+      looked(input, 1);
+      if (input.length() == 0) { failedAt(input); return Failure { "ch_fn: No input" }; }
       if (m(input[0])) return Success { {input[0]}, input.substr(1) };
 
+      failedAt(input);
       return Failure { "" };
-    };
+    }, {}, {}, [m](string_view input) -> Match {
+      looked(input, 1);
+      if (input.length() > 0 && m(input[0])) return 1;
+      failedAt(input);
+      return nullopt;
+    } };
   }
 
   Parser ch(const char match) {
-    return [match](const string input) -> Result {
-      if (input.length() == 0) return Failure {"ch: No input"};
+    return Node { Node::Kind::ch, [match](string_view input) -> Result {
+      looked(input, 1);
+      if (input.length() == 0) { failedAt(input); return Failure {"ch: No input"}; }
       if (input[0] == match) {
         return Success { {match}, input.substr(1) };
       }
+      failedAt(input);
       return Failure { std::string("ch: No match for '") + std::string(1, match) };
-    };
+    }, {}, { match }, [match](string_view input) -> Match {
+      looked(input, 1);
+      if (input.length() > 0 && input[0] == match) return 1;
+      failedAt(input);
+      return nullopt;
+    } };
   }
 
   Parser alpha() {
-    return [](const string input) -> Result {
+    return Node { Node::Kind::alpha, [](string_view input) -> Result {
+      looked(input, 1);
       if (input.length() > 0 && isalpha(input[0])) {
         return Success { { input[0] }, input.substr(1) };
       }
 
+      failedAt(input);
       return Failure { "Expected alphanumeric character" };
-    };
+    }, {}, {}, [](string_view input) -> Match {
+      looked(input, 1);
+      if (input.length() > 0 && isalpha(input[0])) return 1;
+      failedAt(input);
+      return nullopt;
+    } };
   }
 
   Parser str(const string match) { 
     // TODO: static_assert(match.length() > 0); if possible?
 
-    return [match](const string input) -> Result {
-      if (input.length() < match.length()) return Failure {"ch: No input"};
+    return Node { Node::Kind::str, [match](string_view input) -> Result {
+      looked(input, match.length());
+      if (input.length() < match.length()) { failedAt(input); return Failure {"ch: No input"}; }
 
-      const string result = input.substr(0, match.length());
-      if (result == match) {
-        return Success { result, input.substr(match.length()) };
+      if (input.substr(0, match.length()) == match) {
+        return Success { match, input.substr(match.length()) };
       }
 
+      failedAt(input);
       return Failure { "No match" };
-    };
+    }, {}, match, [match](string_view input) -> Match {
+      looked(input, match.length());
+      if (input.substr(0, match.length()) == match) return match.length();
+      failedAt(input);
+      return nullopt;
+    } };
   }
 
   Parser oneOf(const std::vector<Parser> parsers) {
-    return [parsers](const string input) -> Result {
-      for (const auto p : parsers) {
-        const auto p_res = p(input);
+    return Node { Node::Kind::oneOf, [parsers](string_view input) -> Result {
+      const Nested nested;
+      if (overBudget()) return outOfBudget();
+      for (const auto& p : parsers) {
+        auto p_res = p(input);
         if (std::holds_alternative<Success>(p_res)) return p_res;
       }
 
       return Failure { "No alternative worked." };
-    };
+    }, parsers, {}, [parsers](string_view input) -> Match {
+      const Nested nested;
+      if (overBudget()) return nullopt;
+      for (const auto& p : parsers) {
+        if (const auto m = p.recognize(input)) return m;
+      }
+      return nullopt;
+    } };
   }
 
+  // What until() knows about the bytes its untilThen parser can start on.
+  // `single`: it matches that byte on its own, whatever comes after, and
+  // `starts`: a match could start with it. Only single character parsers,
+  // literals and oneOf them are looked into; anything else could start
+  // anywhere. Parsers are taken to be pure (memo() relies on that too), so
+  // the single character ones are simply tried on every byte.
+  struct ByteClass {
+    array<bool, 256> single {};
+    array<bool, 256> starts {};
+  };
+
+  ByteClass byteClass(const Parser& p) {
+    using Kind = Node::Kind;
+    const auto& node = *p.node;
+    ByteClass out;
+
+    switch (node.kind) {
+      case Kind::ch: case Kind::ch_fn: case Kind::alpha: case Kind::set: {
+        const auto saved = pair { furthest, reached };
+        for (size_t b = 0; b < 256; ++b) {
+          const char c = static_cast<char>(b);
+          out.single[b] = out.starts[b] = p.recognize(string_view { &c, 1 }) == 1;
+        }
+        tie(furthest, reached) = saved;
+        return out;
+      }
+      case Kind::str:
+        if (node.text.empty()) break;
+        out.starts[static_cast<unsigned char>(node.text[0])] = true;
+        return out;
+      case Kind::andThen: case Kind::xImplies: {
+        if (node.children.empty()) break;
+        const auto first = node.children[0].node->kind;
+        if (first != Kind::ch && first != Kind::ch_fn && first != Kind::alpha && first != Kind::set && first != Kind::str) break;
+        out.starts = byteClass(node.children[0]).starts;
+        return out;
+      }
+      case Kind::oneOf:
+        // The first alternative that could start with a byte is the one
+        // that decides it
+        for (const auto& child : node.children) {
+          const auto c = byteClass(child);
+          for (size_t b = 0; b < 256; ++b) {
+            out.single[b] = out.single[b] || (!out.starts[b] && c.single[b]);
+            out.starts[b] = out.starts[b] || c.starts[b];
+          }
+        }
+        return out;
+      default:
+        break;
+    }
+
+    out.starts.fill(true);
+    return out;
+  }
+
+  // A break point for until() that is a literal (ch or str): it can only
+  // match where its text is, which memchr finds far quicker than trying it
+  // at every offset. Longer literals go through string_view::find, which in
+  // libstdc++ is also a memchr for the first byte and then a compare; for
+  // delimiters like "*/" or "-->" that is as good as a skip table.
+  struct Literal {
+    string text;
+    // Bytes untilThen takes one at a time, see ByteClass
+    array<bool, 256> plain;
+
+    // Offset of the next occurrence at or after `from`, the end if there
+    // is none
+    size_t find(const string_view input, const size_t from) const {
+      if (from >= input.length()) return input.length();
+      if (text.length() == 1) {
+        const auto* at = static_cast<const char*>(memchr(input.data() + from, text[0], input.length() - from));
+        return at ? at - input.data() : input.length();
+      }
+      return min(input.find(text, from), input.length());
+    }
+
+    // Moves `n` over the plain bytes before `end`, with the looked() and
+    // failedAt() calls the break point and untilThen would have made
+    size_t skip(const string_view input, const size_t n, const size_t end) const {
+      auto i = n;
+      while (i < end && plain[static_cast<unsigned char>(input[i])]) ++i;
+      if (i > n) {
+        looked(input.substr(i - 1), text.length());
+        failedAt(input.substr(i - 1));
+      }
+      return i;
+    }
+
+    // What trying the break point at `input` would leave behind, for an
+    // offset that find() says it can't match at
+    void missed(const string_view input) const {
+      looked(input, text.length());
+      failedAt(input);
+    }
+  };
+
   Parser until(const Parser breakPoint, const Parser untilThen) {
-    return [breakPoint, untilThen](const string input) -> Result {
+    std::optional<Literal> literal;
+    const auto& node = *breakPoint.node;
+    if ((node.kind == Node::Kind::ch || node.kind == Node::Kind::str) && !node.text.empty()) literal = Literal { node.text, byteClass(untilThen).single };
+
+    return Node { Node::Kind::until, [breakPoint, untilThen, literal](string_view input) -> Result {
+      const Nested nested;
       std::string result {""};
-      auto remaining { input };
+      size_t n = 0;
+      // Where the literal break point is next; it can't match before that
+      size_t next = literal ? literal->find(input, 0) : 0;
 
       while (true) {
-        if (remaining.length() == 0) { return Failure { "until: No more input" }; }
+        if (overBudget()) return outOfBudget();
+        if (literal) {
+          if (n > next) next = literal->find(input, n);
+          const auto end = literal->skip(input, n, next);
+          result.append(input.substr(n, end - n));
+          n = end;
+        }
 
-        const auto b_res = breakPoint(remaining);
-        if (std::holds_alternative<Failure>(b_res)) {
-          const auto u_res = untilThen(remaining);
-          if (std::holds_alternative<Failure>(u_res)) {
-            return u_res;
-          }
+        const auto remaining = input.substr(n);
+        if (remaining.length() == 0) { looked(remaining, 1); failedAt(remaining); return Failure { "until: No more input" }; }
 
-          const auto u = std::get<Success>(u_res);
-          result.append(std::get<0>(u));
-          remaining = remaining.substr(std::get<0>(u).length());
+        if (literal && n < next) {
+          literal->missed(remaining);
         } else {
-          const auto b = std::get<Success>(b_res);
-          result.append(std::get<0>(b));
-          return Success { result, remaining.substr(std::get<0>(b).length()) };
+          const auto b_res = breakPoint(remaining);
+          if (std::holds_alternative<Success>(b_res)) {
+            const auto& b = std::get<Success>(b_res);
+            result.append(std::get<0>(b));
+            return Success { std::move(result), remaining.substr(std::get<0>(b).length()) };
+          }
         }
+
+        const auto u_res = untilThen(remaining);
+        if (std::holds_alternative<Failure>(u_res)) {
+          return u_res;
+        }
+
+        const auto& u = std::get<Success>(u_res);
+        result.append(std::get<0>(u));
+        n += std::get<0>(u).length();
       }
-    };
+    }, { breakPoint, untilThen }, {}, [breakPoint, untilThen, literal](string_view input) -> Match {
+      const Nested nested;
+      size_t n = 0;
+      size_t next = literal ? literal->find(input, 0) : 0;
+
+      while (true) {
+        if (overBudget()) return nullopt;
+        if (literal) {
+          if (n > next) next = literal->find(input, n);
+          n = literal->skip(input, n, next);
+        }
+
+        const auto remaining = input.substr(n);
+        if (remaining.length() == 0) { looked(remaining, 1); failedAt(remaining); return nullopt; }
+
+        if (literal && n < next) {
+          literal->missed(remaining);
+        } else if (const auto b = breakPoint.recognize(remaining)) {
+          return n + *b;
+        }
+
+        const auto u = untilThen.recognize(remaining);
+        if (!u) return nullopt;
+        n += *u;
+      }
+    } };
   }
 
   Parser repeatedly(const Parser matchOn, std::optional<Parser> joinedBy = std::nullopt) {
-    return [matchOn, joinedBy](const string input) -> Result {
-      std::string remaining { input };
+    return Node { Node::Kind::repeatedly, [matchOn, joinedBy](string_view input) -> Result {
+      const Nested nested;
+      std::string_view remaining { input };
       std::string match { "" };
 
       std::string appendage { "" };
 
       while (true) {
+        if (overBudget()) return outOfBudget();
         if (remaining.length() == 0) break;
 
         const auto m_res = matchOn(remaining);
         if (std::holds_alternative<Failure>(m_res)) break;
 
-        const auto m = std::get<Success>(m_res);
+        const auto& m = std::get<Success>(m_res);
         match.append(appendage);
         appendage = "";
         match.append(std::get<0>(m));
@@ -150,7 +511,7 @@ namespace match {
           const auto j_res = joinedBy.value()(remaining);
           if (std::holds_alternative<Failure>(j_res)) break;
 
-          const auto j = std::get<Success>(j_res);
+          const auto& j = std::get<Success>(j_res);
           // match.append(std::get<0>(j));
           appendage = std::get<0>(j);
           remaining = std::get<1>(j);
@@ -159,40 +520,102 @@ namespace match {
 
       if (match.length() == 0) return Failure { "repatedly: no match" };
       if (appendage.length() != 0) return Failure { "repeatedly: dangling appendage" };
-      return Success { match, remaining };
-    };
+      return Success { std::move(match), remaining };
+    }, joinedBy ? vector<Parser> { matchOn, *joinedBy } : vector<Parser> { matchOn }, {}, [matchOn, joinedBy](string_view input) -> Match {
+      const Nested nested;
+      size_t n = 0;
+      // What the items and the separators between them matched, and the
+      // last separator, which only counts if another item follows
+      size_t matched = 0;
+      size_t appendage = 0;
+
+      while (true) {
+        if (overBudget()) return nullopt;
+        if (n == input.length()) break;
+
+        const auto m = matchOn.recognize(input.substr(n));
+        if (!m) break;
+        matched += appendage + *m;
+        appendage = 0;
+        n += *m;
+
+        if (joinedBy) {
+          const auto j = joinedBy->recognize(input.substr(n));
+          if (!j) break;
+          appendage = *j;
+          n += *j;
+        }
+      }
+
+      if (matched == 0 || appendage != 0) return nullopt;
+      return n;
+    } };
+  }
+
+  // One character out of `members`
+  Parser set(const string members) {
+    array<bool, 256> table {};
+    for (const char c : members) table[static_cast<unsigned char>(c)] = true;
+
+    return Node { Node::Kind::set, [table](string_view input) -> Result {
+      looked(input, 1);
+      if (input.length() == 0) { failedAt(input); return Failure { "set: No input" }; }
+      if (table[static_cast<unsigned char>(input[0])]) return Success { { input[0] }, input.substr(1) };
+
+      failedAt(input);
+      return Failure { "set: No match" };
+    }, {}, members, [table](string_view input) -> Match {
+      looked(input, 1);
+      if (input.length() > 0 && table[static_cast<unsigned char>(input[0])]) return 1;
+      failedAt(input);
+      return nullopt;
+    } };
   }
 }
 
 namespace seq {
   // TODO: Use array/initializer_list?
   Parser andThen(const std::vector<Parser> parsers) {
-    return [parsers](const string input) -> Result {
+    return Node { Node::Kind::andThen, [parsers](string_view input) -> Result {
+      const Nested nested;
+      if (overBudget()) return outOfBudget();
       string result {""};
-      string remaining {input};
-      for (const auto p : parsers) {
+      string_view remaining {input};
+      for (const auto& p : parsers) {
         const auto p_res = p(remaining);
         if (std::holds_alternative<Failure>(p_res)) return p_res;
-        const auto p_succ = std::get<Success>(p_res); 
+        const auto& p_succ = std::get<Success>(p_res);
         result.append(std::get<0>(p_succ));
         remaining = std::get<1>(p_succ);
       }
 
-      return Success { result, remaining };
-    };
+      return Success { std::move(result), remaining };
+    }, parsers, {}, [parsers](string_view input) -> Match {
+      const Nested nested;
+      if (overBudget()) return nullopt;
+      size_t n = 0;
+      for (const auto& p : parsers) {
+        const auto m = p.recognize(input.substr(n));
+        if (!m) return nullopt;
+        n += *m;
+      }
+      return n;
+    } };
   }
 
   Parser some(const Parser p) {
-    return [p](const string input) -> Result {
+    return Node { Node::Kind::some, [p](string_view input) -> Result {
+      const Nested nested;
       string result {""};
-      string remaining {input};
+      string_view remaining {input};
 
       while (true) {
+        if (overBudget()) return outOfBudget();
         const auto p_res = p(remaining);
 
         if (std::holds_alternative<Failure>(p_res)) break;
 
-        const auto s = std::get<Success>(p_res);
+        const auto& s = std::get<Success>(p_res);
         result.append(std::get<0>(s));
         remaining = remaining.substr(std::get<0>(s).length());
       }
@@ -200,23 +623,38 @@ namespace seq {
       if (result.length() == 0) {
         return Failure { "No result for some" };
       }
-      return Success { result, remaining };
-    };
+      return Success { std::move(result), remaining };
+    }, { p }, {}, [p](string_view input) -> Match {
+      const Nested nested;
+      size_t n = 0;
+
+      while (true) {
+        if (overBudget()) return nullopt;
+        const auto m = p.recognize(input.substr(n));
+        if (!m) break;
+        n += *m;
+      }
+
+      if (n == 0) return nullopt;
+      return n;
+    } };
   }
 
   Parser any(const Parser p) {
-    return [p](const string input) -> Result {
-      if (input.length() == 0) return Success { "", "" };
+    return Node { Node::Kind::any, [p](string_view input) -> Result {
+      if (input.length() == 0) return Success { "", input };
 
+      const Nested nested;
       string result {""};
-      string remaining {input};
+      string_view remaining {input};
 
       while (true) {
+        if (overBudget()) return outOfBudget();
         const auto p_res = p(remaining);
 
         if (std::holds_alternative<Failure>(p_res)) break;
 
-        const auto s = std::get<Success>(p_res);
+        const auto& s = std::get<Success>(p_res);
         // TODO: Use Maybe instead?
         if (std::get<0>(s).length() == 0) break;
 
@@ -224,8 +662,22 @@ namespace seq {
         remaining = remaining.substr(std::get<0>(s).length());
       }
 
-      return Success { result, remaining };
-    };
+      return Success { std::move(result), remaining };
+    }, { p }, {}, [p](string_view input) -> Match {
+      if (input.length() == 0) return 0;
+
+      const Nested nested;
+      size_t n = 0;
+
+      while (true) {
+        if (overBudget()) return nullopt;
+        const auto m = p.recognize(input.substr(n));
+        if (!m || *m == 0) break;
+        n += *m;
+      }
+
+      return n;
+    } };
   }
 
   /*
@@ -241,23 +693,934 @@ namespace seq {
   TODO: xImplies and oneOf are not usable together if xImplies is the first argument (it returns Success even if it matches nothing)
   */
  Parser xImplies(const std::array<Parser, 2> parsers) {
-    return [parsers](const string input) -> Result {
+    return Node { Node::Kind::xImplies, [parsers](string_view input) -> Result {
         const auto f_res = parsers[0](input);
 
         if (std::holds_alternative<Failure>(f_res)) return Success { "", input };
-        const auto f = std::get<Success>(f_res);
+        const auto& f = std::get<Success>(f_res);
         auto build { std::get<0>(f) };
 
         const auto s_res = parsers[1](input.substr(build.length()));
         // TODO: Combined error message somehow
         if (std::holds_alternative<Failure>(s_res)) return s_res;
-        const auto s = std::get<Success>(s_res);
+        const auto& s = std::get<Success>(s_res);
         build.append(std::get<0>(s));
 
-        return Success { build, std::get<1>(s) };
+        return Success { std::move(build), std::get<1>(s) };
+    }, { parsers[0], parsers[1] }, {}, [parsers](string_view input) -> Match {
+        const auto f = parsers[0].recognize(input);
+        if (!f) return 0;
+
+        const auto s = parsers[1].recognize(input.substr(*f));
+        if (!s) return nullopt;
+        return *f + *s;
+    } };
+  }
+}
+
+namespace seq {
+  // The longest run of characters out of `members`, which may be empty.
+  // Same as any(match::set(members)), in one loop.
+  Parser span(const string members) {
+    array<bool, 256> table {};
+    for (const char c : members) table[static_cast<unsigned char>(c)] = true;
+
+    return Node { Node::Kind::span, [table](string_view input) -> Result {
+      size_t n = 0;
+      while (n < input.length() && table[static_cast<unsigned char>(input[n])]) ++n;
+      looked(input, n + 1);
+
+      return Success { string(input.substr(0, n)), input.substr(n) };
+    }, {}, members, [table](string_view input) -> Match {
+      size_t n = 0;
+      while (n < input.length() && table[static_cast<unsigned char>(input[n])]) ++n;
+      looked(input, n + 1);
+      return n;
+    } };
+  }
+}
+
+// How many characters out of `table` `input` starts with. Reports what it
+// looked at the same way any(set) would, so that skipping whitespace leaves
+// furthest/reached where a grammar spelling it out would have them.
+size_t skipped(const array<bool, 256>& table, const string_view input) {
+  if (input.empty()) return 0;
+
+  size_t n = 0;
+  while (n < input.length() && table[static_cast<unsigned char>(input[n])]) ++n;
+  looked(input, n + 1);
+  failedAt(input.substr(n));
+  return n;
+}
+
+// The characters in `members` skipped in one loop, then `p`. What phrase()
+// puts in front of every token; the match includes what was skipped. A
+// single character token is checked right there in the same scan.
+Parser skip(const string members, const Parser p) {
+  array<bool, 256> table {};
+  for (const char c : members) table[static_cast<unsigned char>(c)] = true;
+
+  if (p.node->kind == Node::Kind::ch || p.node->kind == Node::Kind::set) {
+    array<bool, 256> token {};
+    for (const char c : p.node->text) token[static_cast<unsigned char>(c)] = true;
+
+    const auto length = [table, token](string_view input) -> Match {
+      const auto n = skipped(table, input);
+      looked(input, n + 1);
+      if (n < input.length() && token[static_cast<unsigned char>(input[n])]) return n + 1;
+      failedAt(input.substr(n));
+      return nullopt;
     };
+    return Node { Node::Kind::skip, [length](string_view input) -> Result {
+      const auto n = length(input);
+      if (!n) return Failure { "skip: No match" };
+      return Success { string(input.substr(0, *n)), input.substr(*n) };
+    }, { p }, members, length };
   }
+
+  return Node { Node::Kind::skip, [table, p](string_view input) -> Result {
+    const auto n = skipped(table, input);
+    auto res = p(input.substr(n));
+    if (n == 0) return res;
+
+    // The match is the input it consumed, so it can be taken from there in one go
+    if (auto* success = get_if<Success>(&res)) get<0>(*success).assign(input.data(), n + get<0>(*success).length());
+    return res;
+  }, { p }, members, [table, p](string_view input) -> Match {
+    const auto n = skipped(table, input);
+    const auto m = p.recognize(input.substr(n));
+    if (!m) return nullopt;
+    return n + *m;
+  } };
 }
 
+// `p` as a single token: phrase() skips in front of it but not inside it,
+// as for a string literal or a number. Anywhere else it is just `p`.
+Parser lexeme(const Parser p) {
+  return Node { Node::Kind::lexeme, [p](string_view input) { return p(input); }, { p }, {},
+                [p](string_view input) { return p.recognize(input); } };
 }
 
+// Results of memo() rules while an Incremental is parsing: which rule ran
+// at which offset, what it returned and how far into the input it looked.
+// Kept sorted by offset so an edit can drop the entries it damaged and
+// shift the ones after it in one pass. New entries go to a small second
+// table first, which is merged into the big one once it has grown enough.
+class Memo {
+public:
+  static constexpr size_t verbatim = size_t(-1);
+
+  struct Entry {
+    const Node* rule;
+    size_t start;
+    // One past the last character the rule looked at
+    size_t last;
+    size_t consumed;
+    bool ok;
+    // Index of the match (or failure message) in texts, or `verbatim` when
+    // the match is just the consumed input, the common case
+    size_t text;
+  };
+
+  const Entry* find(const Node* rule, const size_t start) {
+    if (const auto e = find(entries, rule, start, cursor)) return e;
+    return find(recent, rule, start, recentCursor);
+  }
+
+  const string& text(const Entry& e) const { return texts[e.text]; }
+
+  void add(const Node* rule, const size_t start, const size_t last, const Result& res, const string_view input) {
+    Entry e { rule, start, last, 0, false, verbatim };
+    if (const auto* success = get_if<Success>(&res)) {
+      e.ok = true;
+      e.consumed = input.length() - get<1>(*success).length();
+      if (get<0>(*success) != input.substr(0, e.consumed)) e.text = keep(get<0>(*success));
+    } else {
+      e.text = keep(get<Failure>(res));
+    }
+    fresh.push_back(e);
+  }
+
+  // Files away what the last parse added
+  void commit() {
+    sort(fresh.begin(), fresh.end(), byStart);
+    merge(recent, fresh);
+    fresh.clear();
+
+    if (recent.size() * 16 > entries.size()) {
+      merge(entries, recent);
+      recent.clear();
+      compact();
+    }
+  }
+
+  // The characters in [offset, offset + removed) were replaced by `inserted`
+  // of them. Anything that looked at or next to the replaced stretch is
+  // dropped, anything after it moves along.
+  void edit(const size_t offset, const size_t removed, const size_t inserted) {
+    for (auto* table : { &entries, &recent }) {
+      const auto end = offset + removed;
+      erase_if(*table, [&](const Entry& e) { return offset <= e.last && end >= e.start; });
+
+      auto after = upper_bound(table->begin(), table->end(), end, [](size_t s, const Entry& e) { return s < e.start; });
+      for (; after != table->end(); ++after) {
+        after->start = after->start - removed + inserted;
+        after->last = after->last - removed + inserted;
+      }
+    }
+  }
+
+  size_t size() const { return entries.size() + recent.size(); }
+
+private:
+  static bool byStart(const Entry& a, const Entry& b) { return a.start < b.start; }
+
+  // A parse asks for offsets mostly in increasing order, so the search
+  // gallops forward from where the last one ended up before bisecting
+  static const Entry* find(const vector<Entry>& table, const Node* rule, const size_t start, size_t& cursor) {
+    const auto before = [](const Entry& e, size_t s) { return e.start < s; };
+
+    auto low = table.begin();
+    auto high = table.end();
+    if (cursor < table.size() && table[cursor].start < start) {
+      low = table.begin() + cursor;
+      for (size_t step = 1; ; step *= 2) {
+        if (size_t(table.end() - low) <= step) break;
+        if (!before(low[step], start)) {
+          high = low + step;
+          break;
+        }
+        low += step;
+      }
+    }
+
+    auto at = lower_bound(low, high, start, before);
+    cursor = at - table.begin();
+    for (; at != table.end() && at->start == start; ++at) {
+      if (at->rule == rule) return &*at;
+    }
+    return nullptr;
+  }
+
+  static void merge(vector<Entry>& into, const vector<Entry>& from) {
+    const auto middle = into.size();
+    into.insert(into.end(), from.begin(), from.end());
+    inplace_merge(into.begin(), into.begin() + middle, into.end(), byStart);
+  }
+
+  size_t keep(string text) {
+    texts.push_back(std::move(text));
+    return texts.size() - 1;
+  }
+
+  // Drops the texts of entries that edits have removed
+  void compact() {
+    vector<string> live;
+    for (auto& e : entries) {
+      if (e.text == verbatim) continue;
+      live.push_back(std::move(texts[e.text]));
+      e.text = live.size() - 1;
+    }
+    texts = std::move(live);
+  }
+
+  vector<Entry> entries;
+  vector<Entry> recent;
+  vector<Entry> fresh;
+  vector<string> texts;
+  size_t cursor = 0;
+  size_t recentCursor = 0;
+};
+
+// Where memo() rules keep their results on this thread, if anywhere
+struct MemoScope {
+  Memo* memo = nullptr;
+  const char* base = nullptr;
+  size_t reused = 0;
+  size_t evaluated = 0;
+};
+thread_local MemoScope memoScope;
+
+// Remembers the results of `p` by offset while an Incremental is parsing,
+// and is just `p` otherwise. Put it around the rules that enclose big
+// stretches of input (a JSON value, a statement), so that an edit leaves
+// most of them intact. `p` may contain opaque parsers only if they report
+// what they look at with looked().
+Parser memo(const Parser p) {
+  const auto run = [p](string_view input) -> Result {
+    auto& scope = memoScope;
+    if (!scope.memo) return p(input);
+
+    const auto start = size_t(input.data() - scope.base);
+    if (const auto e = scope.memo->find(p.node.get(), start)) {
+      ++scope.reused;
+      looked(input, e->last - start);
+      if (!e->ok) return Failure { scope.memo->text(*e) };
+
+      auto match = e->text == Memo::verbatim ? string(input.substr(0, e->consumed)) : scope.memo->text(*e);
+      return Success { std::move(match), input.substr(e->consumed) };
+    }
+
+    ++scope.evaluated;
+    const auto outer = reached;
+    reached = input.data();
+    auto res = p(input);
+    scope.memo->add(p.node.get(), start, size_t(reached - scope.base), res, input);
+
+    if (less<const char*> {}(reached, outer)) reached = outer;
+    return res;
+  };
+
+  return Node { Node::Kind::memo, run, { p }, {}, [p, run](string_view input) -> Match {
+    if (!memoScope.memo) return p.recognize(input);
+
+    const auto res = run(input);
+    if (const auto* success = get_if<Success>(&res)) return input.length() - get<1>(*success).length();
+    return nullopt;
+  } };
+}
+
+// Keeps a document and the memo() results of its last parse, so that after
+// an edit only the rules around the edit run again.
+//
+//   Incremental doc(json::parser(), text);
+//   doc.edit(120, 1, "7");   // same as parsing the edited text from scratch
+class Incremental {
+public:
+  struct Stats {
+    // memo() results taken from the last parse, and rules that had to run
+    size_t reused = 0;
+    size_t evaluated = 0;
+    size_t entries = 0;
+  };
+
+  Incremental(Parser root, string text) : root(std::move(root)), document(std::move(text)) {
+    parse();
+  }
+
+  // The result refers to text(), it is good until the next edit
+  const Result& edit(const size_t offset, const size_t removed, const string_view inserted) {
+    document.replace(offset, removed, inserted);
+    memo.edit(offset, removed, inserted.length());
+    return parse();
+  }
+
+  const Result& result() const { return last; }
+  const string& text() const { return document; }
+  Stats stats() const { return counts; }
+
+private:
+  const Result& parse() {
+    // memo() finds out what its rules depend on through `reached`
+    const Tracked tracked;
+    auto& scope = memoScope;
+    const auto outer = scope;
+    scope = { &memo, document.data() };
+
+    last = root(document);
+    memo.commit();
+    counts = { scope.reused, scope.evaluated, memo.size() };
+
+    scope = outer;
+    return last;
+  }
+
+  Parser root;
+  string document;
+  Memo memo;
+  Result last;
+  Stats counts;
+};
+
+// The structure of a grammar as text, e.g. andThen(ch('-'), some(ch_fn)).
+// Opaque parsers show up as `fn`, without looking inside.
+string describe(const Parser& p) {
+  using Kind = Node::Kind;
+  if (!p) return "null";
+
+  const auto quoted = [](const string_view text, const char quote) {
+    string out { quote };
+    for (const char c : text) {
+      switch (c) {
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        case '\r': out += "\\r"; break;
+        case '\\': out += "\\\\"; break;
+        default:
+          if (c == quote) out += '\\';
+          out += c;
+      }
+    }
+    return out + quote;
+  };
+
+  const auto& node = *p.node;
+  const auto name = [&node]() -> string {
+    switch (node.kind) {
+      case Kind::fn: return "fn";
+      case Kind::ch: return "ch";
+      case Kind::ch_fn: return "ch_fn";
+      case Kind::alpha: return "alpha";
+      case Kind::str: return "str";
+      case Kind::oneOf: return "oneOf";
+      case Kind::until: return "until";
+      case Kind::repeatedly: return "repeatedly";
+      case Kind::andThen: return "andThen";
+      case Kind::some: return "some";
+      case Kind::any: return "any";
+      case Kind::xImplies: return "xImplies";
+      case Kind::optional: return "optional";
+      case Kind::set: return "set";
+      case Kind::span: return "span";
+      case Kind::memo: return "memo";
+      case Kind::lexeme: return "lexeme";
+      case Kind::skip: return "skip";
+      case Kind::binary: return "binary";
+      case Kind::prefixed: return "prefixed";
+      case Kind::count: return "count";
+    }
+    return "?";
+  };
+
+  switch (node.kind) {
+    case Kind::fn: case Kind::ch_fn: case Kind::alpha:
+      return name();
+    case Kind::ch: case Kind::set: case Kind::span:
+      return name() + "(" + quoted(node.text, '\'') + ")";
+    case Kind::str:
+      return name() + "(" + quoted(node.text, '"') + ")";
+    case Kind::skip:
+      return name() + "(" + quoted(node.text, '\'') + ", " + describe(node.children[0]) + ")";
+    case Kind::binary:
+      return name() + "(" + node.text + ")";
+    case Kind::count:
+      if (!node.text.empty()) return name() + "(" + node.text + ", " + describe(node.children[0]) + ")";
+      break;
+    default:
+      break;
+  }
+
+  string out = name() + "(";
+  for (size_t i = 0; i < node.children.size(); ++i) {
+    if (i) out += ", ";
+    out += describe(node.children[i]);
+  }
+  return out + ")";
+}
+
+// `p` made again with `children` in place of its own, for the combinators
+// whose node says all there is to know about them; anything else (fn,
+// binary, ...) can't be remade and comes back as it is.
+Parser rebuilt(const Parser& p, const vector<Parser>& children) {
+  using Kind = Node::Kind;
+  switch (p.node->kind) {
+    case Kind::andThen: return seq::andThen(children);
+    case Kind::oneOf: return match::oneOf(children);
+    case Kind::any: return seq::any(children[0]);
+    case Kind::some: return seq::some(children[0]);
+    case Kind::optional: return parsec::optional(children[0]);
+    case Kind::until: return match::until(children[0], children[1]);
+    case Kind::repeatedly: return children.size() == 2 ? match::repeatedly(children[0], children[1]) : match::repeatedly(children[0]);
+    case Kind::xImplies: return seq::xImplies({ children[0], children[1] });
+    case Kind::memo: return memo(children[0]);
+    case Kind::lexeme: return lexeme(children[0]);
+    case Kind::skip: return skip(p.node->text, children[0]);
+    default: return p;
+  }
+}
+
+// Rewrites a grammar into one that matches exactly the same inputs with the
+// same results (failure messages aside), but with less work per character:
+//  - nested andThen/oneOf are flattened into their parent
+//  - runs of ch/str inside an andThen become a single str
+//  - runs of ch/set alternatives inside a oneOf become a single set
+//  - any(set) becomes a span, a single loop over a lookup table
+//  - repetition of something that already repeats (any(any(p)), any(span),
+//    optional(any(p)), ...) loses the redundant layer
+// Opaque parsers are kept as they are, and shared subgrammars stay shared.
+Parser optimize(const Parser& p) {
+  using Kind = Node::Kind;
+
+  struct Pass {
+    map<const Node*, Parser> done;
+
+    Parser run(const Parser& p) {
+      if (!p) return p;
+      if (const auto found = done.find(p.node.get()); found != done.end()) return found->second;
+
+      const auto result = rewrite(p);
+      done.emplace(p.node.get(), result);
+      return result;
+    }
+
+    static bool is(const Parser& p, const Kind kind) { return p.node->kind == kind; }
+
+    Parser rewrite(const Parser& p) {
+      const auto& node = *p.node;
+
+      vector<Parser> children;
+      bool changed = false;
+      for (const auto& child : node.children) {
+        children.push_back(run(child));
+        changed = changed || children.back().node != child.node;
+      }
+
+      switch (node.kind) {
+        case Kind::andThen: {
+          vector<Parser> flat;
+          for (const auto& child : children) {
+            if (is(child, Kind::andThen)) {
+              flat.insert(flat.end(), child.node->children.begin(), child.node->children.end());
+            } else {
+              flat.push_back(child);
+            }
+          }
+
+          vector<Parser> merged;
+          for (size_t i = 0; i < flat.size(); ) {
+            size_t j = i;
+            string literal;
+            while (j < flat.size() && (is(flat[j], Kind::ch) || is(flat[j], Kind::str))) literal += flat[j++].node->text;
+
+            if (j - i > 1) {
+              merged.push_back(match::str(literal));
+              i = j;
+            } else {
+              merged.push_back(flat[i++]);
+            }
+          }
+
+          if (merged.size() == 1) return merged[0];
+          if (merged.size() == node.children.size() && !changed && flat.size() == merged.size()) return p;
+          return seq::andThen(merged);
+        }
+
+        case Kind::oneOf: {
+          vector<Parser> flat;
+          for (const auto& child : children) {
+            if (is(child, Kind::oneOf)) {
+              flat.insert(flat.end(), child.node->children.begin(), child.node->children.end());
+            } else {
+              flat.push_back(child);
+            }
+          }
+
+          vector<Parser> merged;
+          for (size_t i = 0; i < flat.size(); ) {
+            size_t j = i;
+            string members;
+            while (j < flat.size() && (is(flat[j], Kind::ch) || is(flat[j], Kind::set))) members += flat[j++].node->text;
+
+            if (j - i > 1) {
+              merged.push_back(match::set(members));
+              i = j;
+            } else {
+              merged.push_back(flat[i++]);
+            }
+          }
+
+          if (merged.size() == 1) return merged[0];
+          if (merged.size() == node.children.size() && !changed && flat.size() == merged.size()) return p;
+          return match::oneOf(merged);
+        }
+
+        case Kind::any: {
+          const auto& child = children[0];
+          if (is(child, Kind::set)) return seq::span(child.node->text);
+          if (is(child, Kind::ch)) return seq::span(child.node->text);
+          if (is(child, Kind::span) || is(child, Kind::any)) return child;
+          return changed ? seq::any(child) : p;
+        }
+
+        case Kind::optional: {
+          const auto& child = children[0];
+          if (is(child, Kind::optional) || is(child, Kind::any) || is(child, Kind::span)) return child;
+          return changed ? parsec::optional(child) : p;
+        }
+
+        default:
+          return changed ? rebuilt(p, children) : p;
+      }
+    }
+  };
+
+  return Pass {}.run(p);
+}
+
+// `p` run as a phrase: the characters in `members` (whitespace, usually)
+// are skipped in front of every token, so the grammar doesn't have to say
+// where they may go. Tokens are ch, str, set, span, ch_fn and alpha, and
+// whatever is wrapped in lexeme(), inside of which nothing is skipped.
+// Nothing is skipped after the last token. The skipping is built into the
+// grammar: each token becomes a skip() node that scans past `members` and
+// then runs it.
+//
+//   const auto list = phrase(andThen({ ch('('), any(lexeme(number)), ch(')') }), " \n");
+//
+// Opaque parsers are left alone, so rules that refer to each other through
+// one are made into phrases one at a time. Call it before optimize(), which
+// fuses tokens and would leave no gaps between them to skip.
+Parser phrase(const Parser& p, const string members) {
+  using Kind = Node::Kind;
+
+  struct Pass {
+    const string& members;
+    map<const Node*, Parser> done;
+
+    Parser run(const Parser& p) {
+      if (!p) return p;
+      if (const auto found = done.find(p.node.get()); found != done.end()) return found->second;
+
+      const auto result = rewrite(p);
+      done.emplace(p.node.get(), result);
+      return result;
+    }
+
+    Parser rewrite(const Parser& p) {
+      const auto& node = *p.node;
+      switch (node.kind) {
+        case Kind::ch: case Kind::str: case Kind::set: case Kind::span: case Kind::ch_fn: case Kind::alpha:
+          return skip(members, p);
+        case Kind::lexeme:
+          return skip(members, node.children[0]);
+        // Already a phrase, possibly skipping something else
+        case Kind::skip:
+          return p;
+        default:
+          break;
+      }
+
+      vector<Parser> children;
+      bool changed = false;
+      for (const auto& child : node.children) {
+        children.push_back(run(child));
+        changed = changed || children.back().node != child.node;
+      }
+      return changed ? rebuilt(p, children) : p;
+    }
+  };
+
+  return Pass { members, {} }.run(p);
+}
+
+// Hash-conses grammars: every node that is equal to one this Sharing has
+// seen before (same kind, same literal, the same children) is replaced by
+// that one, so a subgrammar written out many times, such as the whitespace
+// around every token, is a single node that all its uses point to. Opaque
+// nodes (fn, ch_fn, the binary ones) are only ever equal to themselves, and
+// memo() rules keep their own tables, so they are never merged either.
+// Use one Sharing across rules that should share with each other.
+class Sharing {
+public:
+  Parser operator()(const Parser& p) {
+    if (!p) return p;
+    if (const auto found = done.find(p.node); found != done.end()) return found->second;
+
+    const auto result = share(p);
+    done.emplace(p.node, result);
+    return result;
+  }
+
+private:
+  using Kind = Node::Kind;
+  using Key = tuple<Kind, string, vector<const Node*>>;
+
+  Parser share(const Parser& p) {
+    const auto& node = *p.node;
+
+    vector<Parser> children;
+    vector<const Node*> ids;
+    bool changed = false;
+    for (const auto& child : node.children) {
+      children.push_back((*this)(child));
+      ids.push_back(children.back().node.get());
+      changed = changed || children.back().node != child.node;
+    }
+
+    switch (node.kind) {
+      case Kind::ch: case Kind::str: case Kind::set: case Kind::span: case Kind::alpha:
+      case Kind::andThen: case Kind::oneOf: case Kind::any: case Kind::some: case Kind::optional:
+      case Kind::until: case Kind::repeatedly: case Kind::xImplies:
+      case Kind::lexeme: case Kind::skip:
+        break;
+      default:
+        return changed ? rebuilt(p, children) : p;
+    }
+
+    const auto [found, added] = canonical.try_emplace(Key { node.kind, node.text, std::move(ids) }, p);
+    if (added && changed) found->second = rebuilt(p, children);
+    return found->second;
+  }
+
+  // Holds on to the nodes it was given as well, so that their addresses
+  // aren't reused while this is still around
+  map<shared_ptr<const Node>, Parser> done;
+  map<Key, Parser> canonical;
+};
+
+Parser share(const Parser& p) { return Sharing {}(p); }
+
+// How big a grammar is in memory: each distinct node with its text and
+// child list, not counting what the closures that run it capture. `tree` is
+// how many nodes it would take if nothing were shared.
+struct Footprint {
+  size_t nodes = 0;
+  size_t bytes = 0;
+  size_t tree = 0;
+};
+
+Footprint footprint(const Parser& p) {
+  struct Walk {
+    map<const Node*, size_t> trees;
+    Footprint out;
+
+    size_t run(const Node& node) {
+      if (const auto found = trees.find(&node); found != trees.end()) return found->second;
+
+      ++out.nodes;
+      // The node, make_shared's control block in front of it, and whatever
+      // the text and children have on the heap
+      out.bytes += sizeof(Node) + 2 * sizeof(void*) + node.children.capacity() * sizeof(Parser);
+      if (node.text.capacity() > string().capacity()) out.bytes += node.text.capacity() + 1;
+
+      size_t tree = 1;
+      for (const auto& child : node.children) tree += run(*child.node);
+      trees.emplace(&node, tree);
+      return tree;
+    }
+  };
+
+  Walk walk;
+  if (p) walk.out.tree = walk.run(*p.node);
+  return walk.out;
+}
+
+// What parse_batch found, as one array per field with an entry per document.
+struct Batch {
+  enum class Status : uint8_t { ok, failed };
+
+  vector<Status> status;
+  // Length of the matched prefix, 0 for failures
+  vector<size_t> consumed;
+  // How far the parser got before failing, npos for successes
+  vector<size_t> errorOffset;
+
+  size_t size() const { return status.size(); }
+
+  void clear() {
+    status.clear();
+    consumed.clear();
+    errorOffset.clear();
+  }
+};
+
+// Runs `p` over every document in turn, for lots of small inputs where the
+// per-call overhead matters as much as the parse. Build `p` once and pass the
+// same `out` in every time, its arrays are reused instead of reallocated.
+void parse_batch(const span<const string_view> documents, const Parser& p, Batch& out) {
+  const Tracked tracked;
+  out.clear();
+  out.status.reserve(documents.size());
+  out.consumed.reserve(documents.size());
+  out.errorOffset.reserve(documents.size());
+
+  for (const auto document : documents) {
+    furthest = document.data();
+    const auto res = p(document);
+
+    if (const auto* success = get_if<Success>(&res)) {
+      out.status.push_back(Batch::Status::ok);
+      out.consumed.push_back(document.size() - get<1>(*success).size());
+      out.errorOffset.push_back(string_view::npos);
+    } else {
+      out.status.push_back(Batch::Status::failed);
+      out.consumed.push_back(0);
+      out.errorOffset.push_back(min(size_t(furthest - document.data()), document.size()));
+    }
+  }
+}
+
+Batch parse_batch(const span<const string_view> documents, const Parser& p) {
+  Batch out;
+  parse_batch(documents, p, out);
+  return out;
+}
+
+struct Bounded {
+  Result result;
+  // Which limit stopped the parse, if any; the result is a Failure then
+  Exceeded exceeded = Exceeded::none;
+  size_t steps = 0;
+};
+
+// Runs `p` within `budget`, for input that may have been made to be slow to
+// parse (deep nesting, long runs, grammars that backtrack a lot). Going over
+// any limit fails the whole parse soon after, with `exceeded` saying which.
+//
+//   const auto res = bounded(json::parser(), body, { .bytes = 1 << 20, .depth = 512, .steps = 1'000'000 });
+Bounded bounded(const Parser& p, const string_view input, const Budget& budget) {
+  if (input.length() > budget.bytes) return { Failure { "budget: Input too long" }, Exceeded::bytes };
+
+  auto& scope = budgetScope;
+  const auto outer = scope;
+  // check = 0 looks at the clock and the cancel flag on the first step
+  scope = { &budget, 0, 0, 0, budget.depth };
+
+  Bounded out { p(input), scope.exceeded, scope.steps };
+  scope = outer;
+
+  switch (out.exceeded) {
+    case Exceeded::depth: out.result = Failure { "budget: Nested too deep" }; break;
+    case Exceeded::steps: out.result = Failure { "budget: Too many steps" }; break;
+    case Exceeded::deadline: out.result = Failure { "budget: Deadline passed" }; break;
+    case Exceeded::cancelled: out.result = Failure { "budget: Cancelled" }; break;
+    default: break;
+  }
+  return out;
+}
+
+
+// A 64 bit hash of `bytes`, read eight at a time into four independent
+// lanes. Fast, not collision resistant: Cache compares bytes on every hit.
+uint64_t hashBytes(const string_view bytes) {
+  const auto load = [&bytes](const size_t at) {
+    uint64_t word;
+    memcpy(&word, bytes.data() + at, 8);
+    return word;
+  };
+  const auto mix = [](uint64_t h, const uint64_t word) { return rotl((h ^ word) * 0x9E3779B97F4A7C15ull, 31); };
+
+  const auto n = bytes.length();
+  uint64_t lanes[4] = { n, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0x27D4EB2F165667C5ull };
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    for (size_t k = 0; k < 4; ++k) lanes[k] = mix(lanes[k], load(i + 8 * k));
+  }
+  for (; i + 8 <= n; i += 8) lanes[0] = mix(lanes[0], load(i));
+
+  uint64_t tail = 0;
+  for (size_t k = 0; i + k < n; ++k) tail |= uint64_t(uint8_t(bytes[i + k])) << (8 * k);
+
+  // splitmix64's finalizer over all of it
+  auto h = mix(lanes[0], tail) ^ rotl(lanes[1], 17) ^ rotl(lanes[2], 34) ^ rotl(lanes[3], 51);
+  h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+  h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+  return h ^ (h >> 31);
+}
+
+// Results of `p` by input, for services that see the same message over and
+// over (heartbeats, repeated config pushes). Inputs are looked up by hash
+// and length, and a hit is only taken once the input compares equal to the
+// bytes it was stored under, so what comes back is always what p would
+// return. Entries are charged for their input, matched text and bookkeeping;
+// past `capacity` bytes the least recently used ones are dropped.
+//
+// Any number of threads can share one: entries are split over shards by
+// hash, each behind its own lock, and p runs outside of them. A hit doesn't
+// run p, so it moves neither furthest/reached nor a budget.
+//
+//   Cache cache { json::parser(), 64 << 20 };
+//   const auto res = cache(body);
+class Cache {
+public:
+  struct Stats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+  };
+
+  Cache(Parser p, const size_t capacity) : p(std::move(p)), shardCapacity(capacity / shardCount) {}
+
+  Result operator()(const string_view input) {
+    const auto hash = hashBytes(input);
+    auto& shard = shards[hash % shardCount];
+
+    {
+      const lock_guard lock { shard.guard };
+      const auto found = shard.index.find(hash);
+      if (found != shard.index.end() && found->second->input == input) {
+        const auto& entry = *found->second;
+        shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+        hits.fetch_add(1, memory_order_relaxed);
+        if (!entry.ok) return Failure { entry.text };
+        return Success { entry.text, input.substr(entry.consumed) };
+      }
+    }
+
+    misses.fetch_add(1, memory_order_relaxed);
+    auto res = p(input);
+    store(shard, hash, input, res);
+    return res;
+  }
+
+  Stats stats() const {
+    Stats out { hits.load(), misses.load(), evictions.load() };
+    for (const auto& shard : shards) {
+      const lock_guard lock { shard.guard };
+      out.entries += shard.lru.size();
+      out.bytes += shard.bytes;
+    }
+    return out;
+  }
+
+private:
+  static constexpr size_t shardCount = 16;
+
+  struct Entry {
+    uint64_t hash;
+    string input;
+    bool ok;
+    // The match, or the failure
+    string text;
+    size_t consumed;
+
+    size_t charge() const { return input.capacity() + text.capacity() + sizeof(Entry) + 8 * sizeof(void*); }
+  };
+
+  struct Shard {
+    mutable mutex guard;
+    // Most recently used first
+    list<Entry> lru;
+    unordered_map<uint64_t, list<Entry>::iterator> index;
+    size_t bytes = 0;
+  };
+
+  void store(Shard& shard, const uint64_t hash, const string_view input, const Result& res) {
+    const auto* success = get_if<Success>(&res);
+    Entry entry { hash, string(input), success != nullptr,
+                  success ? get<0>(*success) : get<Failure>(res),
+                  success ? input.length() - get<1>(*success).length() : 0 };
+    const auto charge = entry.charge();
+    if (charge > shardCapacity) return;
+
+    const lock_guard lock { shard.guard };
+    // Another thread got there first, or a different input with the same hash
+    if (const auto found = shard.index.find(hash); found != shard.index.end()) drop(shard, found->second);
+
+    shard.lru.push_front(std::move(entry));
+    shard.index.emplace(hash, shard.lru.begin());
+    shard.bytes += charge;
+
+    while (shard.bytes > shardCapacity) {
+      drop(shard, prev(shard.lru.end()));
+      evictions.fetch_add(1, memory_order_relaxed);
+    }
+  }
+
+  void drop(Shard& shard, const list<Entry>::iterator entry) {
+    shard.bytes -= entry->charge();
+    shard.index.erase(entry->hash);
+    shard.lru.erase(entry);
+  }
+
+  Parser p;
+  size_t shardCapacity;
+  array<Shard, shardCount> shards;
+  atomic<size_t> hits = 0;
+  atomic<size_t> misses = 0;
+  atomic<size_t> evictions = 0;
+};
+
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "./parsec.hpp"
+
+// Combinators for binary framing: fixed width integers in either byte order,
+// LEB128 varints, length-prefixed slices and counted repetition. They are
+// ordinary parsers whose match is the raw bytes, so they compose with
+// andThen/oneOf like the rest, and recognize() runs them without copying
+// anything.
+//
+//   // A u16 big endian count, then that many u32 little endian values
+//   const auto values = binary::count(binary::u16be(), binary::u32le());
+namespace parsec::binary {
+using namespace std;
+
+// A parser for an integer field, and how to get the value back out of what
+// it matched. prefixed() and count() take their lengths from one of these;
+// any parser can be made into one, e.g. for lengths kept in the low bits of
+// a tag byte:
+//
+//   Integer(match::ch_fn(isFixstr), [](string_view tag) -> uint64_t { return tag[0] & 0x1f; })
+class Integer : public Parser {
+public:
+  using Decode = uint64_t (*)(string_view);
+
+  Integer(Parser p, Decode decode) : Parser(std::move(p)), decode(decode) {}
+
+  Decode decode;
+};
+
+template <size_t N, endian Order>
+uint64_t load(const string_view bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < N; ++i) {
+    const uint64_t byte = uint8_t(bytes[i]);
+    value |= byte << (8 * (Order == endian::little ? i : N - 1 - i));
+  }
+  return value;
+}
+
+// `n` bytes, whatever they are; `name` is what describe() shows
+Parser fixed(const size_t n, string name) {
+  return Node { Node::Kind::binary, [n](string_view input) -> Result {
+    looked(input, n);
+    if (input.length() < n) { failedAt(input); return Failure { "binary: No input" }; }
+    return Success { string(input.substr(0, n)), input.substr(n) };
+  }, {}, std::move(name), [n](string_view input) -> Match {
+    looked(input, n);
+    if (input.length() < n) { failedAt(input); return nullopt; }
+    return n;
+  } };
+}
+
+Parser bytes(const size_t n) { return fixed(n, to_string(n)); }
+
+Integer u8() { return { fixed(1, "u8"), load<1, endian::little> }; }
+Integer u16le() { return { fixed(2, "u16le"), load<2, endian::little> }; }
+Integer u16be() { return { fixed(2, "u16be"), load<2, endian::big> }; }
+Integer u32le() { return { fixed(4, "u32le"), load<4, endian::little> }; }
+Integer u32be() { return { fixed(4, "u32be"), load<4, endian::big> }; }
+Integer u64le() { return { fixed(8, "u64le"), load<8, endian::little> }; }
+Integer u64be() { return { fixed(8, "u64be"), load<8, endian::big> }; }
+
+// Length of the LEB128 varint at the start of `input`, 0 if there is none
+// (it runs out, or goes on past the ten bytes a 64 bit value needs)
+size_t varintLength(const string_view input) {
+  const auto limit = min<size_t>(input.length(), 10);
+  for (size_t i = 0; i < limit; ++i) {
+    if (!(uint8_t(input[i]) & 0x80)) return i + 1;
+  }
+  return 0;
+}
+
+uint64_t varintValue(const string_view bytes) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < bytes.length(); ++i) value |= uint64_t(uint8_t(bytes[i]) & 0x7f) << (7 * i);
+  return value;
+}
+
+// An unsigned LEB128 varint, as in protobuf
+Integer varint() {
+  return { Node { Node::Kind::binary, [](string_view input) -> Result {
+    const auto n = varintLength(input);
+    looked(input, n ? n : input.length() + 1);
+    if (!n) { failedAt(input); return Failure { "varint: Unterminated" }; }
+    return Success { string(input.substr(0, n)), input.substr(n) };
+  }, {}, "varint", [](string_view input) -> Match {
+    const auto n = varintLength(input);
+    looked(input, n ? n : input.length() + 1);
+    if (!n) { failedAt(input); return nullopt; }
+    return n;
+  } }, varintValue };
+}
+
+// How much of `input` a `length` field and the bytes it counts take up
+Match prefixedLength(const Integer& length, const string_view input) {
+  const auto field = length.recognize(input);
+  if (!field) return nullopt;
+
+  const auto n = length.decode(input.substr(0, *field));
+  const auto rest = input.substr(*field);
+  looked(rest, n);
+  if (n > rest.length()) { failedAt(rest); return nullopt; }
+  return *field + n;
+}
+
+// A `length` field and then that many bytes; the match is both
+Parser prefixed(const Integer length) {
+  return Node { Node::Kind::prefixed, [length](string_view input) -> Result {
+    const auto n = prefixedLength(length, input);
+    if (!n) return Failure { "prefixed: Not enough input" };
+    return Success { string(input.substr(0, *n)), input.substr(*n) };
+  }, { length }, {}, [length](string_view input) -> Match {
+    return prefixedLength(length, input);
+  } };
+}
+
+// The bytes a prefixed(length) at the start of `input` counts, as a view
+std::optional<string_view> payload(const Integer& length, const string_view input) {
+  const auto n = prefixedLength(length, input);
+  if (!n) return nullopt;
+
+  const auto field = *length.recognize(input);
+  return input.substr(field, *n - field);
+}
+
+// `p` exactly `times` times, starting at offset `n`. A `p` that matched
+// nothing would match nothing every time after, so that ends it early.
+Match repeat(const Parser& p, const uint64_t times, const string_view input, size_t n) {
+  const Nested nested;
+  for (uint64_t i = 0; i < times; ++i) {
+    if (overBudget()) return nullopt;
+    const auto m = p.recognize(input.substr(n));
+    if (!m) return nullopt;
+    if (*m == 0) break;
+    n += *m;
+  }
+  return n;
+}
+
+Result repeatRun(const Parser& p, const uint64_t times, const string_view input, string result) {
+  const Nested nested;
+  auto remaining = input.substr(result.length());
+  for (uint64_t i = 0; i < times; ++i) {
+    if (overBudget()) return outOfBudget();
+    auto res = p(remaining);
+    if (holds_alternative<Failure>(res)) return res;
+
+    const auto& s = get<Success>(res);
+    if (get<0>(s).empty()) break;
+    result.append(get<0>(s));
+    remaining = get<1>(s);
+  }
+  return Success { std::move(result), remaining };
+}
+
+// `p`, `times` times over
+Parser count(const uint64_t times, const Parser p) {
+  return Node { Node::Kind::count, [times, p](string_view input) -> Result {
+    return repeatRun(p, times, input, "");
+  }, { p }, to_string(times), [times, p](string_view input) -> Match {
+    return repeat(p, times, input, 0);
+  } };
+}
+
+// A `length` field, and then `p` as many times as it says
+Parser count(const Integer length, const Parser p) {
+  return Node { Node::Kind::count, [length, p](string_view input) -> Result {
+    const auto field = length.recognize(input);
+    if (!field) return Failure { "count: No length" };
+    return repeatRun(p, length.decode(input.substr(0, *field)), input, string(input.substr(0, *field)));
+  }, { length, p }, {}, [length, p](string_view input) -> Match {
+    const auto field = length.recognize(input);
+    if (!field) return nullopt;
+    return repeat(p, length.decode(input.substr(0, *field)), input, *field);
+  } };
+}
+
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+// A subset of the combinators that works in constant expressions. There is
+// no std::function and no std::string here: a parser is a plain struct whose
+// type spells out the grammar, and running one only answers "how many
+// characters did it match" (nullopt when it failed). That is enough to check
+// literals in a static_assert, and a grammar made of these is itself constant,
+// so it can be constinit/constexpr and costs nothing at startup.
+//
+//   constexpr auto sign = ct::optional(ct::oneOf(ct::ch('-'), ct::ch('+')));
+//   static_assert(ct::matches(ct::andThen(sign, ct::str<"inf">), "-inf"));
+namespace parsec::ct {
+using namespace std;
+
+using Match = std::optional<size_t>;
+
+// A string literal usable as a template argument, for str<"...">
+template <size_t N>
+struct fixed_string {
+  char chars[N] {};
+
+  constexpr fixed_string(const char (&literal)[N]) { copy_n(literal, N, chars); }
+
+  constexpr string_view view() const { return { chars, N - 1 }; }
+};
+
+template <typename P>
+concept Parser = is_invocable_r_v<Match, const P&, string_view>;
+
+struct Ch {
+  char match;
+
+  constexpr Match operator()(const string_view input) const {
+    if (input.empty() || input[0] != match) return nullopt;
+    return 1;
+  }
+};
+
+template <typename F>
+struct ChFn {
+  F matcher;
+
+  constexpr Match operator()(const string_view input) const {
+    if (input.empty() || !matcher(input[0])) return nullopt;
+    return 1;
+  }
+};
+
+template <fixed_string S>
+struct Str {
+  constexpr Match operator()(const string_view input) const {
+    if (!input.starts_with(S.view())) return nullopt;
+    return S.view().size();
+  }
+};
+
+template <Parser... Ps>
+struct OneOf {
+  tuple<Ps...> parsers;
+
+  constexpr Match operator()(const string_view input) const {
+    Match res;
+    apply([&](const auto&... p) { (void) ((res = p(input)) || ...); }, parsers);
+    return res;
+  }
+};
+
+template <Parser... Ps>
+struct AndThen {
+  tuple<Ps...> parsers;
+
+  constexpr Match operator()(const string_view input) const {
+    size_t at = 0;
+    const auto step = [&](const auto& p) {
+      const auto res = p(input.substr(at));
+      if (res) at += *res;
+      return res.has_value();
+    };
+    if (!apply([&](const auto&... p) { return (step(p) && ...); }, parsers)) return nullopt;
+    return at;
+  }
+};
+
+// Zero or more; like seq::any it stops at a match that consumed nothing.
+template <Parser P>
+struct Any {
+  P p;
+
+  constexpr Match operator()(const string_view input) const {
+    size_t at = 0;
+    while (true) {
+      const auto res = p(input.substr(at));
+      if (!res || *res == 0) break;
+      at += *res;
+    }
+    return at;
+  }
+};
+
+template <Parser P>
+struct Some {
+  P p;
+
+  constexpr Match operator()(const string_view input) const {
+    const auto res = Any<P> { p }(input);
+    if (*res == 0) return nullopt;
+    return res;
+  }
+};
+
+template <Parser P>
+struct Optional {
+  P p;
+
+  constexpr Match operator()(const string_view input) const {
+    return p(input).value_or(0);
+  }
+};
+
+constexpr Ch ch(const char match) { return { match }; }
+
+template <typename F>
+constexpr ChFn<F> ch_fn(const F matcher) { return { matcher }; }
+
+template <fixed_string S>
+constexpr Str<S> str {};
+
+template <Parser... Ps>
+constexpr OneOf<Ps...> oneOf(const Ps... parsers) { return { { parsers... } }; }
+
+template <Parser... Ps>
+constexpr AndThen<Ps...> andThen(const Ps... parsers) { return { { parsers... } }; }
+
+template <Parser P>
+constexpr Some<P> some(const P p) { return { p }; }
+
+template <Parser P>
+constexpr Any<P> any(const P p) { return { p }; }
+
+template <Parser P>
+constexpr Optional<P> optional(const P p) { return { p }; }
+
+// Whether `p` matches all of `input`
+template <Parser P>
+constexpr bool matches(const P& p, const string_view input) {
+  return p(input) == input.size();
+}
+
+}
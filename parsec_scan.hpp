@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// What the hand written scanners (json/scan.hpp, csv/scan.hpp) have in
+// common: how they report the end of a scan, and the bit tricks they use to
+// look at 64 bytes at a time.
+namespace parsec::scan {
+
+// Where a scan stopped, and why if it failed
+struct status {
+    std::size_t offset = 0;
+    const char* error = nullptr;
+
+    explicit operator bool() const { return error == nullptr; }
+};
+
+// Bit i is set when an odd number of bits at or below i are set in `x`
+std::uint64_t prefix_xor(std::uint64_t x) {
+    for (int shift = 1; shift < 64; shift <<= 1) x ^= x << shift;
+    return x;
+}
+
+} // namespace parsec::scan
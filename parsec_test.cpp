@@ -1,5 +1,10 @@
 #include <catch2/catch_test_macros.hpp>
 #include "./parsec.hpp"
+#include "./alloc.hpp"
+#include "./parsec_ct.hpp"
+#include "./parsec_binary.hpp"
+
+#include <thread>
 
 using namespace parsec;
 
@@ -121,6 +126,46 @@ TEST_CASE("match::until") {
   const auto parser = parsec::match::until(breakAt, untilThen);
   
   REQUIRE ( is_success(parser("1247124124\"123123")) );
+
+  SECTION("a literal break point behaves as an opaque one") {
+    using namespace parsec::match;
+    // The same parser, hidden from until() so it tries it everywhere
+    const auto opaque = [](const Parser& p) -> Parser {
+      return Node { Node::Kind::fn, p.node->run, {}, {}, p.node->recognize };
+    };
+    const auto escape = seq::andThen({ ch('\\'), ch_fn([](const char) { return true; }) });
+
+    const std::vector<std::pair<Parser, Parser>> cases {
+      { ch('"'), untilThen },
+      { ch('"'), ch_fn([](const char in) { return in != '\\'; }) },
+      { ch('"'), oneOf({ escape, ch_fn([](const char in) { return in != '\\'; }) }) },
+      { str("*/"), ch_fn([](const char) { return true; }) },
+      { str("*/"), oneOf({ str("**"), set("1a*/") }) },
+      { str("-->"), seq::some(ch('-')) },
+    };
+
+    const std::string alphabet = "1a*/\\\"-";
+    for (const auto& [breakPoint, then] : cases) {
+      const auto fast = until(breakPoint, then);
+      const auto slow = until(opaque(breakPoint), then);
+
+      for (std::size_t k = 0; k < 40000; ++k) {
+        std::string in;
+        for (auto i = k; i; i /= alphabet.size() + 1) {
+          if (i % (alphabet.size() + 1)) in += alphabet[i % (alphabet.size() + 1) - 1];
+        }
+
+        const auto effects = [&in](const auto& run) {
+          const parsec::Tracked tracked;
+          parsec::furthest = parsec::reached = nullptr;
+          const auto out = run();
+          return std::tuple { out, parsec::furthest ? parsec::furthest - in.data() : -1, parsec::reached ? parsec::reached - in.data() : -1 };
+        };
+        REQUIRE( effects([&] { return fast.recognize(in); }) == effects([&] { return slow.recognize(in); }) );
+        REQUIRE( effects([&] { return fast(in); }) == effects([&] { return slow(in); }) );
+      }
+    }
+  }
 }
 
 
@@ -146,4 +191,567 @@ TEST_CASE("match::repeatedly") {
     REQUIRE( is_failure(parser("1, 5, ")) );
     REQUIRE( is_failure(parser(", 1")) );
   }
-}
\ No newline at end of file
+}
+
+
+TEST_CASE("describe") {
+  const auto parser = parsec::seq::andThen({
+    parsec::optional(parsec::match::ch('-')),
+    parsec::seq::some(parser_A),
+    parsec::match::str("F\"O"),
+    [](std::string_view) -> Result { return Failure { "opaque" }; }
+  });
+
+  REQUIRE( describe(parser) == "andThen(optional(ch('-')), some(ch_fn), str(\"F\\\"O\"), fn)" );
+}
+
+TEST_CASE("optimize") {
+  using namespace parsec;
+
+  const auto sign = match::oneOf({ match::ch('-'), match::ch('+') });
+  const auto whitespace = seq::any(match::oneOf({ match::ch(' '), match::ch('\t') }));
+
+  GIVEN("char alternatives") {
+    REQUIRE( describe(optimize(sign)) == "set('-+')" );
+    REQUIRE( describe(optimize(match::oneOf({ sign, match::ch('e'), parser_FOO, match::ch('x') })))
+      == "oneOf(set('-+e'), str(\"FOO\"), ch('x'))" );
+  }
+
+  GIVEN("repetition of a char set") {
+    REQUIRE( describe(optimize(whitespace)) == "span(' \\t')" );
+    REQUIRE( describe(optimize(seq::any(whitespace))) == "span(' \\t')" );
+    REQUIRE( describe(optimize(parsec::optional(seq::any(parser_A)))) == "any(ch_fn)" );
+  }
+
+  GIVEN("nested sequences") {
+    const auto parser = seq::andThen({
+      match::ch('a'),
+      seq::andThen({ match::ch('b'), match::str("cd"), seq::some(parser_A) }),
+      seq::andThen({ match::ch('e') }),
+    });
+    REQUIRE( describe(optimize(parser)) == "andThen(str(\"abcd\"), some(ch_fn), ch('e'))" );
+  }
+
+  GIVEN("a grammar with nothing to do") {
+    const auto parser = seq::some(parser_A);
+    REQUIRE( optimize(parser).node == parser.node );
+  }
+
+  GIVEN("any input") {
+    const auto grammar = match::repeatedly(
+      seq::andThen({
+        seq::any(whitespace),
+        match::oneOf({ seq::andThen({ match::ch('['), match::ch(']') }), match::ch('x'), match::ch('y'), parser_FOO }),
+        parsec::optional(seq::any(sign)),
+      }),
+      seq::andThen({ match::ch(','), seq::any(whitespace) })
+    );
+    const auto optimized = optimize(grammar);
+
+    THEN("the optimized grammar gives the same results") {
+      const std::string alphabet = " \t[]xyFO,-+";
+      for (std::size_t n = 0; n < 20000; ++n) {
+        std::string in;
+        for (auto k = n; k; k /= alphabet.size() + 1) {
+          if (k % (alphabet.size() + 1)) in += alphabet[k % (alphabet.size() + 1) - 1];
+        }
+        const auto expected = grammar(in);
+        const auto actual = optimized(in);
+
+        REQUIRE( expected.index() == actual.index() );
+        if (is_success(expected)) {
+          REQUIRE( std::get<Success>(expected) == std::get<Success>(actual) );
+        }
+      }
+    }
+
+    THEN("recognizing matches as much as parsing does") {
+      const std::string alphabet = " \t[]xyFO,-+";
+      for (std::size_t n = 0; n < 20000; ++n) {
+        std::string in;
+        for (auto k = n; k; k /= alphabet.size() + 1) {
+          if (k % (alphabet.size() + 1)) in += alphabet[k % (alphabet.size() + 1) - 1];
+        }
+        const auto res = grammar(in);
+        const auto expected = is_success(res) ? Match(in.size() - std::get<1>(std::get<Success>(res)).size()) : std::nullopt;
+
+        REQUIRE( grammar.recognize(in) == expected );
+        REQUIRE( optimized.recognize(in) == expected );
+      }
+    }
+  }
+}
+
+TEST_CASE("Incremental") {
+  const auto digit = [](const char in) { return in >= '0' && in <= '9'; };
+  // Lists of numbers and nested lists, e.g. [1,[2,3],[]]
+  Parser list;
+  const auto item = memo(match::oneOf({
+    seq::some(match::ch_fn(digit)),
+    [&list](const std::string_view in) { return list(in); },
+  }));
+  list = memo(seq::andThen({ match::ch('['), parsec::optional(match::repeatedly(item, match::ch(','))), match::ch(']') }));
+  const auto strict = seq::andThen({ list, match::ch('.') });
+
+  const auto same = [](const Result& a, const Result& b) {
+    return a.index() == b.index() && (is_failure(a) || std::get<Success>(a) == std::get<Success>(b));
+  };
+
+  GIVEN("a document") {
+    Incremental doc(strict, "[1,[22,333],[],[4,[5]],666].");
+    REQUIRE( result_eq(doc.result(), "[1,[22,333],[],[4,[5]],666].", "") );
+    REQUIRE( doc.stats().reused == 0 );
+
+    THEN("an edit only reparses around it") {
+      const auto& res = doc.edit(5, 1, "7");
+      REQUIRE( result_eq(res, "[1,[27,333],[],[4,[5]],666].", "") );
+      REQUIRE( doc.stats().reused > 0 );
+      REQUIRE( doc.stats().evaluated < 8 );
+    }
+
+    THEN("edits that break and repair it agree with a fresh parse") {
+      const std::vector<std::tuple<std::size_t, std::size_t, std::string>> edits {
+        { 0, 1, "" }, { 0, 0, "[" }, { 27, 1, "" }, { 27, 0, "." }, { 3, 9, "" }, { 3, 0, "[22,333]," },
+        { 14, 0, "[8,9]," }, { 10, 3, "1,2,3,4" }, { 2, 0, "x" }, { 2, 1, "" }, { 28, 0, "]" },
+      };
+      for (const auto& [offset, removed, inserted] : edits) {
+        doc.edit(offset, removed, inserted);
+        REQUIRE( same(doc.result(), strict(doc.text())) );
+      }
+    }
+  }
+
+  GIVEN("every single-character edit") {
+    const std::string base = "[1,[22,333],[],[4,[5]],666].";
+    const std::string alphabet = "[],.1";
+    for (std::size_t i = 0; i <= base.size(); ++i) {
+      for (const char c : alphabet) {
+        Incremental doc(strict, base);
+        doc.edit(i, 0, std::string(1, c));
+        REQUIRE( same(doc.result(), strict(doc.text())) );
+        doc.edit(i, 1, "");
+        REQUIRE( same(doc.result(), strict(base)) );
+        if (i < base.size()) {
+          doc.edit(i, 1, std::string(1, c));
+          REQUIRE( same(doc.result(), strict(doc.text())) );
+        }
+      }
+    }
+  }
+
+  SECTION("memo is plain `p` outside of an Incremental") {
+    REQUIRE( result_eq(strict("[1,2].x"), "[1,2].", "x") );
+    REQUIRE( describe(item) == "memo(oneOf(some(ch_fn), fn))" );
+  }
+}
+
+TEST_CASE("bounded") {
+  using namespace parsec::match;
+  using namespace parsec::seq;
+
+  // Tries both alternatives at every level before failing: 2^levels steps
+  auto slow = some(ch('a'));
+  for (int i = 0; i < 40; ++i) slow = oneOf({ andThen({ slow, ch('b') }), andThen({ slow, ch('c') }) });
+
+  // Parentheses around an x, nested as deep as the input goes
+  // (refers to itself through a plain pointer, a shared_ptr would be a cycle)
+  Parser inner;
+  const auto nested = oneOf({ andThen({ ch('('), Parser([rule = &inner](std::string_view in) { return (*rule)(in); }), ch(')') }), ch('x') });
+  inner = nested;
+  const auto deep = std::string(1000, '(') + "x" + std::string(1000, ')');
+
+  SECTION("within the budget the result is the same") {
+    const auto res = bounded(nested, deep, { .depth = 10000, .steps = 1'000'000 });
+    REQUIRE( res.exceeded == Exceeded::none );
+    REQUIRE( result_eq(res.result, deep, "") );
+    REQUIRE( res.steps > 1000 );
+  }
+
+  SECTION("each limit") {
+    const auto steps = bounded(slow, "aaaad", { .steps = 10000 });
+    REQUIRE( steps.exceeded == Exceeded::steps );
+    REQUIRE( std::get<Failure>(steps.result) == "budget: Too many steps" );
+    REQUIRE( steps.steps < 10100 );
+
+    REQUIRE( bounded(nested, deep, { .depth = 100 }).exceeded == Exceeded::depth );
+    REQUIRE( bounded(nested, deep, { .bytes = 1000 }).exceeded == Exceeded::bytes );
+    REQUIRE( bounded(slow, "aaaad", { .deadline = std::chrono::steady_clock::now() }).exceeded == Exceeded::deadline );
+
+    std::atomic<bool> cancel = true;
+    REQUIRE( bounded(slow, "aaaad", { .cancel = &cancel }).exceeded == Exceeded::cancelled );
+  }
+
+  SECTION("the limits only hold inside bounded()") {
+    REQUIRE( bounded(nested, deep, { .depth = 100 }).exceeded == Exceeded::depth );
+    REQUIRE( result_eq(nested(deep), deep, "") );
+  }
+}
+
+namespace ct_grammar {
+  namespace ct = parsec::ct;
+
+  constexpr auto digit = ct::ch_fn([](const char c) { return c >= '0' && c <= '9'; });
+  constexpr auto sign = ct::optional(ct::oneOf(ct::ch('-'), ct::ch('+')));
+  constexpr auto integer = ct::andThen(sign, ct::some(digit));
+  constexpr auto version = ct::andThen(ct::str<"v">, integer, ct::any(ct::andThen(ct::ch('.'), integer)));
+  // Initialized at compile time, no dynamic initializer runs for it
+  constinit auto list = ct::andThen(ct::ch('['), ct::optional(ct::andThen(integer, ct::any(ct::andThen(ct::ch(','), integer)))), ct::ch(']'));
+
+  static_assert(ct::str<"FOO">("FOOBAR") == 3);
+  static_assert(!ct::str<"FOO">("BAR"));
+  static_assert(integer("-12x") == 3);
+  static_assert(!integer("x"));
+  static_assert(ct::any(digit)("x") == 0);
+  static_assert(ct::matches(version, "v1.2.-3"));
+  static_assert(!ct::matches(version, "v1.2."));
+}
+
+TEST_CASE("binary") {
+  const std::string le("\x01\x02\x03\x04", 4);
+
+  SECTION("integers") {
+    REQUIRE( result_eq(binary::u16le()(le), "\x01\x02", "\x03\x04") );
+    REQUIRE( binary::u16le().decode(le) == 0x0201 );
+    REQUIRE( binary::u16be().decode(le) == 0x0102 );
+    REQUIRE( binary::u32le().decode(le) == 0x04030201 );
+    REQUIRE( is_failure(binary::u64be()(le)) );
+    REQUIRE( binary::u64be().recognize(le) == nullopt );
+  }
+
+  SECTION("varint") {
+    const std::string three("\xac\x82\x01", 3);
+    REQUIRE( binary::varint().recognize(three + "x") == 3 );
+    REQUIRE( binary::varint().decode(three) == 0x412c );
+    REQUIRE( binary::varint().recognize(three.substr(0, 2)) == nullopt );
+    REQUIRE( binary::varint().recognize(std::string(11, '\x80')) == nullopt );
+  }
+
+  SECTION("prefixed") {
+    const auto p = binary::prefixed(binary::u8());
+    REQUIRE( result_eq(p("\x03" "abcde"), "\x03" "abc", "de") );
+    REQUIRE( binary::payload(binary::u8(), "\x03" "abcde") == "abc" );
+    REQUIRE( p.recognize("\x03" "ab") == nullopt );
+    REQUIRE( binary::payload(binary::u8(), "\x03" "ab") == nullopt );
+  }
+
+  SECTION("count") {
+    REQUIRE( result_eq(binary::count(2, binary::u16be())(le + "x"), le, "x") );
+    REQUIRE( is_failure(binary::count(3, binary::u16be())(le)) );
+
+    const auto strings = binary::count(binary::u8(), binary::prefixed(binary::u8()));
+    REQUIRE( strings.recognize(std::string("\x02\x01" "a\x02" "bc!")) == 6 );
+    REQUIRE( result_eq(strings(std::string("\x00!", 2)), std::string(1, '\0'), "!") );
+    REQUIRE( strings.recognize("\x03\x01" "a\x02" "bc") == nullopt );
+  }
+
+  SECTION("composes with the rest") {
+    const auto p = seq::andThen({ match::ch('M'), binary::prefixed(binary::u16be()), match::oneOf({ binary::count(2, binary::u8()), match::ch('!') }) });
+    REQUIRE( result_eq(p(std::string("M\x00\x02" "hi!", 6)), std::string("M\x00\x02" "hi!", 6), "") );
+    REQUIRE( p.recognize(std::string("M\x00\x02" "hixyz", 8)) == 7 );
+    REQUIRE( describe(p) == "andThen(ch('M'), prefixed(binary(u16be)), oneOf(count(2, binary(u8)), ch('!')))" );
+  }
+}
+
+TEST_CASE("share") {
+  using namespace parsec::match;
+  using namespace parsec::seq;
+  const auto digit = [](const char in) { return in >= '0' && in <= '9'; };
+  const auto list = andThen({ any(ch('a')), ch(','), any(ch('a')), parsec::optional(ch_fn(digit)), parsec::optional(ch_fn(digit)) });
+  const auto shared = share(list);
+  const auto& children = shared.node->children;
+
+  REQUIRE( children[0].node == children[2].node );
+  REQUIRE( children[0].node->children[0].node == children[2].node->children[0].node );
+  // ch_fn is opaque, two of them are never the same even if they look it
+  REQUIRE( children[3].node != children[4].node );
+  REQUIRE( result_eq(shared("aa,a1x"), "aa,a1", "x") );
+  REQUIRE( describe(shared) == describe(list) );
+
+  const auto before = footprint(list);
+  const auto after = footprint(shared);
+  REQUIRE( before.nodes == 10 );
+  REQUIRE( after.nodes == 8 );
+  REQUIRE( after.tree == before.tree );
+  REQUIRE( after.bytes < before.bytes );
+
+  SECTION("across rules") {
+    Sharing sharing;
+    const auto x = sharing(andThen({ ch('x'), any(ch('a')) }));
+    const auto y = sharing(oneOf({ ch('y'), any(ch('a')) }));
+    REQUIRE( x.node->children[1].node == y.node->children[1].node );
+    REQUIRE( sharing(ch('x')).node == x.node->children[0].node );
+  }
+
+  SECTION("memo rules keep their own tables") {
+    const auto twice = share(oneOf({ memo(ch('a')), memo(ch('a')) }));
+    REQUIRE( twice.node->children[0].node != twice.node->children[1].node );
+    REQUIRE( twice.node->children[0].node->children[0].node == twice.node->children[1].node->children[0].node );
+  }
+}
+
+TEST_CASE("phrase") {
+  using namespace parsec::match;
+  using namespace parsec::seq;
+  const auto word = some(ch('a'));
+  const auto list = phrase(andThen({ ch('('), any(andThen({ lexeme(word), parsec::optional(ch(',')) })), ch(')') }), " \n");
+
+  REQUIRE( result_eq(list("(aa, a ,aaa)"), "(aa, a ,aaa)", "") );
+  REQUIRE( result_eq(list(" ( a\n) "), " ( a\n)", " ") );
+  REQUIRE( result_eq(list("()x"), "()", "x") );
+  REQUIRE( is_failure(list("(a,,a)")) );
+  // Nothing is skipped inside a lexeme
+  const auto ab = andThen({ ch('a'), ch('b') });
+  REQUIRE( result_eq(phrase(ab, " ")(" a b"), " a b", "") );
+  REQUIRE( result_eq(phrase(lexeme(ab), " ")(" ab "), " ab", " ") );
+  REQUIRE( is_failure(phrase(lexeme(ab), " ")(" a b")) );
+  REQUIRE( list.recognize("( a )") == 5 );
+  REQUIRE( describe(list) == "andThen(skip(' \\n', ch('(')), any(andThen(skip(' \\n', some(ch('a'))), optional(skip(' \\n', ch(','))))), skip(' \\n', ch(')')))" );
+
+  SECTION("same as spelling the whitespace out") {
+    const auto space = any(oneOf({ ch(' '), ch('\n') }));
+    const auto spelled = andThen({ space, ch('('), any(andThen({ space, word, parsec::optional(andThen({ space, ch(',') })) })), space, ch(')') });
+    const std::string alphabet = "a (),\n";
+
+    for (std::size_t k = 0; k < 40000; ++k) {
+      std::string in;
+      for (auto i = k; i; i /= alphabet.size() + 1) {
+        if (i % (alphabet.size() + 1)) in += alphabet[i % (alphabet.size() + 1) - 1];
+      }
+
+      const auto effects = [&in](const auto& run) {
+        const parsec::Tracked tracked;
+        parsec::furthest = parsec::reached = nullptr;
+        const auto out = run();
+        return std::tuple { out, parsec::furthest ? parsec::furthest - in.data() : -1, parsec::reached ? parsec::reached - in.data() : -1 };
+      };
+      REQUIRE( effects([&] { return list.recognize(in); }) == effects([&] { return spelled.recognize(in); }) );
+      REQUIRE( is_success(list(in)) == is_success(spelled(in)) );
+    }
+  }
+
+  SECTION("optimize() keeps the gaps") {
+    const auto pair = phrase(andThen({ ch('<'), ch('>'), any(oneOf({ ch('x'), ch('y') })) }), " ");
+    const auto optimized = optimize(pair);
+    for (const auto* in : { "<>", "< > x y", "<>xy ", "<> x  yx" }) {
+      REQUIRE( optimized(in) == pair(in) );
+    }
+    REQUIRE( is_success(optimized("< > x y")) );
+  }
+}
+
+TEST_CASE("Cache") {
+  const auto numbers = parsec::seq::andThen({ parsec::match::ch('['), parsec::seq::some(parser_A), parsec::match::ch(']') });
+
+  SECTION("hits give back what the parser would") {
+    parsec::Cache cache { numbers, 1 << 20 };
+    const std::string first = "[AA]rest";
+    const std::string again = first;
+
+    REQUIRE( result_eq(cache(first), "[AA]", "rest") );
+    const auto res = cache(again);
+    REQUIRE( result_eq(res, "[AA]", "rest") );
+    // The rest is a view of the input that was passed, not the stored one
+    REQUIRE( std::get<1>(std::get<Success>(res)).data() == again.data() + 4 );
+
+    REQUIRE( is_failure(cache("[AB]")) );
+    REQUIRE( cache("[AB]") == numbers("[AB]") );
+    REQUIRE( result_eq(cache("[AA]tser"), "[AA]", "tser") );
+
+    const auto stats = cache.stats();
+    REQUIRE( stats.hits == 2 );
+    REQUIRE( stats.misses == 3 );
+    REQUIRE( stats.entries == 3 );
+    REQUIRE( stats.evictions == 0 );
+  }
+
+  SECTION("the least recently used entries go first") {
+    // About two entries per shard, but all these land in whichever shards
+    parsec::Cache cache { numbers, 16 * 2 * 256 };
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 200; ++i) inputs.push_back("[" + std::string(1 + i % 50, 'A') + "]" + std::to_string(i));
+    for (const auto& input : inputs) cache(input);
+
+    const auto stats = cache.stats();
+    REQUIRE( stats.evictions > 0 );
+    REQUIRE( stats.entries == 200 - stats.evictions );
+    REQUIRE( stats.bytes <= 16 * 2 * 256 );
+
+    // The last one is still there
+    cache(inputs.back());
+    REQUIRE( cache.stats().hits == 1 );
+  }
+
+  SECTION("many threads") {
+    parsec::Cache cache { numbers, 1 << 16 };
+    std::vector<std::string> inputs;
+    for (int i = 0; i < 64; ++i) inputs.push_back("[" + std::string(1 + i % 7, 'A') + (i % 5 ? "]" : "B]") + std::to_string(i));
+
+    std::atomic<int> wrong = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&, t] {
+        for (int round = 0; round < 200; ++round) {
+          const auto& input = inputs[(round * 7 + t) % inputs.size()];
+          if (cache(input) != numbers(input)) ++wrong;
+        }
+      });
+    }
+    for (auto& thread : threads) thread.join();
+
+    REQUIRE( wrong == 0 );
+    const auto stats = cache.stats();
+    REQUIRE( stats.hits + stats.misses == 800 );
+    REQUIRE( stats.entries == inputs.size() );
+  }
+
+  SECTION("hashBytes") {
+    std::string text(100, 'x');
+    const auto h = parsec::hashBytes(text);
+    for (std::size_t i = 0; i < text.size(); ++i) {
+      auto changed = text;
+      changed[i] ^= 1;
+      REQUIRE( parsec::hashBytes(changed) != h );
+      REQUIRE( parsec::hashBytes(std::string_view(text).substr(0, i)) != h );
+    }
+  }
+}
+
+TEST_CASE("parsec::ct") {
+  // The same parsers work at run time
+  const std::string input = "v10.20";
+  REQUIRE( ct_grammar::version(input) == input.size() );
+  REQUIRE( ct_grammar::integer(std::string("+")) == std::nullopt );
+  REQUIRE( ct_grammar::list(std::string("[1,-2,3]")) == 8 );
+  REQUIRE( alloc::allocations([&] { ct_grammar::version(input); }) == 0 );
+}
+
+// Upper bounds on heap allocations per combinator, so that a change which
+// makes one of them allocate more fails here. Lower them when they improve.
+TEST_CASE("allocations") {
+  const auto allocations = [](const Parser& p, const std::string& in) {
+    return alloc::allocations([&] { p(in); });
+  };
+  const auto digit = [](const char in) { return in >= '0' && in <= '9'; };
+
+  SECTION("match::ch") {
+    REQUIRE( allocations(parsec::match::ch('A'), "AB") == 0 );
+    REQUIRE( allocations(parsec::match::ch('A'), "BB") <= 2 ); // the failure message
+  }
+
+  SECTION("match::ch_fn") {
+    REQUIRE( allocations(parser_A, "AB") == 0 );
+    REQUIRE( allocations(parser_A, "BB") == 0 );
+  }
+
+  SECTION("match::alpha") {
+    REQUIRE( allocations(parsec::match::alpha(), "ab") == 0 );
+  }
+
+  SECTION("match::str") {
+    REQUIRE( allocations(parser_FOO, "FOOBAR") == 0 );
+    REQUIRE( allocations(parser_FOO, "BAR") == 0 );
+  }
+
+  SECTION("match::oneOf") {
+    const auto xOrY = parsec::match::oneOf({ parsec::match::ch('x'), parsec::match::ch('y') });
+    REQUIRE( allocations(xOrY, "xz") == 0 );
+    REQUIRE( allocations(xOrY, "yz") <= 2 );
+    REQUIRE( allocations(xOrY, "zz") <= 5 );
+  }
+
+  SECTION("match::until") {
+    const auto parser = parsec::match::until(parsec::match::ch('"'), parsec::match::ch_fn(digit));
+    REQUIRE( allocations(parser, std::string(32, '1') + "\"") <= 2 ); // the match, too long to be a small string
+  }
+
+  SECTION("match::repeatedly") {
+    const auto parser = parsec::match::repeatedly(parsec::match::ch_fn(digit), parsec::match::str(", "));
+    REQUIRE( allocations(parser, "1, 2, 3, 4") == 0 );
+  }
+
+  SECTION("seq::andThen") {
+    const auto abc = parsec::seq::andThen({ parsec::match::ch('a'), parsec::match::ch('b'), parsec::match::ch('c') });
+    REQUIRE( allocations(abc, "abcd") == 0 );
+  }
+
+  SECTION("seq::some") {
+    REQUIRE( allocations(parsec::seq::some(parser_FOO), "FOOFOOFOOFOOBAR") == 0 );
+  }
+
+  SECTION("seq::any") {
+    REQUIRE( allocations(parsec::seq::any(parser_FOO), "FOOFOOFOOFOOBAR") == 0 );
+  }
+
+  SECTION("seq::xImplies") {
+    const auto xThenY = parsec::seq::xImplies({ parsec::match::ch('x'), parsec::match::ch('Y') });
+    REQUIRE( allocations(xThenY, "xY") == 0 );
+  }
+
+  SECTION("optional") {
+    REQUIRE( allocations(parsec::optional(parser_A), "A") == 0 );
+    REQUIRE( allocations(parsec::optional(parsec::match::ch('A')), "B") <= 2 );
+  }
+
+  SECTION("match::set") {
+    REQUIRE( allocations(parsec::match::set("xyz"), "yz") == 0 );
+    REQUIRE( allocations(parsec::match::set("xyz"), "az") == 0 );
+  }
+
+  SECTION("seq::span") {
+    REQUIRE( allocations(parsec::seq::span(" \n"), "   x") == 0 );
+    REQUIRE( allocations(parsec::seq::span(" \n"), std::string(40, ' ')) <= 1 ); // the match
+  }
+
+  SECTION("skip") {
+    REQUIRE( allocations(parsec::skip(" ", parsec::match::ch('a')), "   ab") == 0 );
+    REQUIRE( allocations(parsec::skip(" ", parsec::match::ch('a')), "   b") == 0 );
+    REQUIRE( allocations(parsec::skip(" ", parser_FOO), "  FOOBAR") == 0 );
+    REQUIRE( allocations(parsec::skip(" ", parser_FOO), std::string(40, ' ') + "FOO") <= 1 ); // the match
+  }
+
+  SECTION("lexeme") {
+    REQUIRE( allocations(parsec::lexeme(parser_FOO), "FOOBAR") == 0 );
+    const auto list = parsec::phrase(parsec::seq::andThen({ parsec::match::ch('('), parsec::lexeme(parser_FOO), parsec::match::ch(')') }), " ");
+    REQUIRE( allocations(list, "( FOO )x") == 0 );
+  }
+
+  SECTION("memo") {
+    REQUIRE( allocations(parsec::memo(parser_FOO), "FOOBAR") == 0 );
+  }
+
+  SECTION("binary") {
+    using namespace parsec::binary;
+    REQUIRE( allocations(u32le(), "abcdef") == 0 );
+    REQUIRE( allocations(varint(), "\x81\x01z") == 0 );
+    REQUIRE( allocations(prefixed(u8()), std::string("\x03") + "abcz") == 0 );
+    REQUIRE( allocations(count(u8(), u16le()), std::string("\x02") + "abcdz") == 0 );
+    REQUIRE( allocations(count(3, u8()), "abcz") == 0 );
+  }
+
+  SECTION("recognize") {
+    const auto number = parsec::match::until(parsec::match::ch('"'), parsec::match::ch_fn(digit));
+    const auto list = parsec::match::repeatedly(parsec::match::oneOf({ number, parsec::match::ch('x') }), parsec::match::str(", "));
+    const auto input = std::string(32, '1') + "\", x, 1\"!";
+    REQUIRE( alloc::allocations([&] { list.recognize(input); }) == 0 );
+    REQUIRE( list.recognize(input) == input.size() - 1 );
+  }
+}
+
+TEST_CASE("parse_batch") {
+  const auto numbers = parsec::seq::andThen({ parsec::match::ch('['), parsec::seq::some(parser_A), parsec::match::ch(']') });
+  const std::vector<std::string_view> documents { "[AAA]", "[A]rest", "[AAB]", "", "[" };
+
+  const auto batch = parsec::parse_batch(documents, numbers);
+  REQUIRE( batch.size() == 5 );
+  REQUIRE( batch.status == std::vector { Batch::Status::ok, Batch::Status::ok, Batch::Status::failed, Batch::Status::failed, Batch::Status::failed } );
+  REQUIRE( batch.consumed == std::vector<size_t> { 5, 3, 0, 0, 0 } );
+  REQUIRE( batch.errorOffset == std::vector<size_t> { std::string_view::npos, std::string_view::npos, 3, 0, 1 } );
+
+  SECTION("the arrays are reused") {
+    Batch out;
+    parsec::parse_batch(documents, numbers, out);
+    const std::vector<std::string_view> valid { "[A]", "[AA]", "[AAA]" };
+    REQUIRE( alloc::allocations([&] { parsec::parse_batch(valid, numbers, out); }) == 0 );
+    REQUIRE( out.consumed == std::vector<size_t> { 3, 4, 5 } );
+  }
+}
@@ -0,0 +1,46 @@
+#include "../parsec.hpp"
+#include "../bench.hpp"
+#include "../json/json.hpp"
+#include "json.peg.hpp"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+std::string document() {
+    std::string doc = "[";
+    for (int i = 0; doc.size() < (1 << 20); ++i) {
+        if (i) doc += ", ";
+        doc += "{\"id\": " + std::to_string(i) + ", \"name\": \"item " + std::to_string(i) + "\", \"tags\": [\"a\", \"b\"], \"score\": -" + std::to_string(i % 97) + ".5e2}";
+    }
+    return doc + "]";
+}
+
+void json_grammar() {
+    const auto doc = document();
+    const auto reference = json::parser(false);
+    const auto optimized = json::parser();
+    const auto generated = json_peg::value();
+
+    bench::report("json::parser(false)", bench::time([&] { bench::keep(reference(doc)); }), doc.size());
+    bench::report("json::parser()", bench::time([&] { bench::keep(optimized(doc)); }), doc.size());
+    bench::report("json_peg::value()", bench::time([&] { bench::keep(generated(doc)); }), doc.size());
+    bench::report("json::parser().recognize()", bench::time([&] { bench::keep(optimized.recognize(doc)); }), doc.size());
+    bench::report("json_peg::value().recognize()", bench::time([&] { bench::keep(generated.recognize(doc)); }), doc.size());
+}
+
+int main(int argc, char** argv) {
+    const std::vector<std::pair<std::string_view, std::function<void()>>> benchmarks {
+        { "json", json_grammar },
+    };
+
+    for (const auto& [name, run] : benchmarks) {
+        if (argc > 1 && name != argv[1]) continue;
+        std::printf("# %.*s\n", int(name.size()), name.data());
+        run();
+    }
+
+    return 0;
+}
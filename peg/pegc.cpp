@@ -0,0 +1,712 @@
+// Generates a recursive descent parser from a grammar file, for grammars that
+// are known at build time and shouldn't pay for a std::function per
+// combinator. Run through add_parsec_grammar() in CMake:
+//
+//   add_parsec_grammar(my_target peg/json.peg)   // #include "json.peg.hpp"
+//
+// The notation is PEG with parsec's combinators and their exact behaviour:
+//
+//   # comment
+//   %namespace json_peg           what the generated code lives in
+//   %include "json/json.hpp"      for the @functions the grammar calls
+//
+//   rule <- a b                   andThen
+//         / c                     oneOf, the first that matches
+//   e*  e+  e?                    any, some, optional
+//   a => b                        xImplies: if a matches b has to follow
+//   until(stop, e)                until
+//   repeatedly(e)  repeatedly(e, separator)
+//   'x'  "xy"  [a-z_]  .          ch, str, set, any single byte
+//   @ns::f                        std::size_t f(std::string_view): length of
+//                                 the match at the start, 0 for none
+//
+// Every rule becomes a parsec::Parser factory of the same name, returning
+// parsec::Result and Match like any other parser, and noting where it
+// failed with parsec::failedAt() the same way the combinators would. They
+// don't take part in memo() or count against a parsec::Budget.
+//
+//   parsec_pegc json.peg json.peg.hpp
+
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+[[noreturn]] void fail(const std::string& where, const std::string& what) {
+    std::fprintf(stderr, "%s: %s\n", where.c_str(), what.c_str());
+    std::exit(1);
+}
+
+struct expr {
+    enum class kind { literal, set, byte, external, rule, sequence, choice, some, any, optional, implies, until, repeatedly };
+
+    kind type;
+    // literal: the bytes, external: the function, rule: its name
+    std::string text {};
+    std::array<bool, 256> members {};
+    std::vector<expr> children {};
+};
+
+struct grammar {
+    std::string name_space = "grammar";
+    std::vector<std::string> includes;
+    std::vector<std::pair<std::string, expr>> rules;
+    std::map<std::string, std::size_t> index;
+};
+
+// The grammar file, read by hand: what it describes is parsers, not values,
+// so the combinators have nothing to hand back here
+class reader {
+public:
+    reader(const std::string& file, std::string text) : file(file), in(std::move(text)) {}
+
+    grammar run() {
+        grammar out;
+        while (skip(), pos < in.size()) {
+            if (in[pos] == '%') {
+                ++pos;
+                const auto directive = identifier();
+                skip();
+                if (directive == "namespace") {
+                    out.name_space = qualified();
+                } else if (directive == "include") {
+                    out.includes.push_back(quoted());
+                } else {
+                    error("Unknown directive %" + directive);
+                }
+                continue;
+            }
+
+            const auto name = identifier();
+            skip();
+            if (!take("<-")) error("Expected '<-' after " + name);
+            if (out.index.count(name)) error("Rule " + name + " defined twice");
+            out.index[name] = out.rules.size();
+            out.rules.emplace_back(name, choice());
+        }
+        if (out.rules.empty()) error("No rules");
+        return out;
+    }
+
+private:
+    [[noreturn]] void error(const std::string& what) const {
+        std::size_t line = 1, column = 1;
+        for (std::size_t i = 0; i < pos && i < in.size(); ++i) {
+            if (in[i] == '\n') {
+                ++line;
+                column = 1;
+            } else {
+                ++column;
+            }
+        }
+        fail(file + ":" + std::to_string(line) + ":" + std::to_string(column), what);
+    }
+
+    void skip() {
+        while (pos < in.size()) {
+            if (std::isspace(static_cast<unsigned char>(in[pos]))) {
+                ++pos;
+            } else if (in[pos] == '#') {
+                while (pos < in.size() && in[pos] != '\n') ++pos;
+            } else {
+                break;
+            }
+        }
+    }
+
+    bool take(const std::string& token) {
+        skip();
+        if (in.compare(pos, token.size(), token) != 0) return false;
+        pos += token.size();
+        return true;
+    }
+
+    static bool word(const char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '_'; }
+
+    std::string identifier() {
+        const auto start = pos;
+        while (pos < in.size() && word(in[pos])) ++pos;
+        if (pos == start) error("Expected a name");
+        return in.substr(start, pos - start);
+    }
+
+    std::string qualified() {
+        auto name = identifier();
+        while (in.compare(pos, 2, "::") == 0) {
+            pos += 2;
+            name += "::" + identifier();
+        }
+        return name;
+    }
+
+    // A name followed by '<-' starts the next rule rather than going on
+    // with this one
+    bool at_rule() {
+        skip();
+        auto at = pos;
+        while (at < in.size() && word(in[at])) ++at;
+        if (at == pos) return false;
+        while (at < in.size() && std::isspace(static_cast<unsigned char>(in[at]))) ++at;
+        return in.compare(at, 2, "<-") == 0;
+    }
+
+    char escaped() {
+        if (pos >= in.size()) error("Unterminated literal");
+        const char c = in[pos++];
+        if (c != '\\') return c;
+        if (pos >= in.size()) error("Unterminated literal");
+
+        switch (const char e = in[pos++]) {
+            case 'n': return '\n';
+            case 'r': return '\r';
+            case 't': return '\t';
+            case '0': return '\0';
+            case 'x': {
+                if (pos + 2 > in.size() || !std::isxdigit(static_cast<unsigned char>(in[pos])) || !std::isxdigit(static_cast<unsigned char>(in[pos + 1]))) {
+                    error("Expected two hex digits after \\x");
+                }
+                const auto value = std::stoi(in.substr(pos, 2), nullptr, 16);
+                pos += 2;
+                return static_cast<char>(value);
+            }
+            default: return e;
+        }
+    }
+
+    std::string quoted() {
+        skip();
+        if (pos >= in.size() || (in[pos] != '"' && in[pos] != '\'')) error("Expected a quoted string");
+        const char quote = in[pos++];
+        std::string out;
+        while (pos < in.size() && in[pos] != quote) out += escaped();
+        if (pos >= in.size()) error("Unterminated literal");
+        ++pos;
+        return out;
+    }
+
+    expr choice() {
+        expr out { expr::kind::choice };
+        out.children.push_back(implies());
+        while (take("/")) out.children.push_back(implies());
+        return out.children.size() == 1 ? std::move(out.children[0]) : out;
+    }
+
+    expr implies() {
+        auto first = sequence();
+        if (!take("=>")) return first;
+        return expr { expr::kind::implies, {}, {}, { std::move(first), sequence() } };
+    }
+
+    bool ends_sequence() {
+        skip();
+        if (pos >= in.size()) return true;
+        const char c = in[pos];
+        return c == '/' || c == ')' || c == ',' || c == '%' || in.compare(pos, 2, "=>") == 0 || at_rule();
+    }
+
+    expr sequence() {
+        expr out { expr::kind::sequence };
+        while (!ends_sequence()) out.children.push_back(postfix());
+        if (out.children.empty()) error("Expected an expression");
+        return out.children.size() == 1 ? std::move(out.children[0]) : out;
+    }
+
+    expr postfix() {
+        auto out = primary();
+        while (pos < in.size()) {
+            const auto type = in[pos] == '*' ? expr::kind::any : in[pos] == '+' ? expr::kind::some : in[pos] == '?' ? expr::kind::optional : expr::kind::byte;
+            if (type == expr::kind::byte) break;
+            ++pos;
+            out = expr { type, {}, {}, { std::move(out) } };
+        }
+        return out;
+    }
+
+    expr primary() {
+        skip();
+        const char c = in[pos];
+
+        if (c == '(') {
+            ++pos;
+            auto out = choice();
+            if (!take(")")) error("Expected ')'");
+            return out;
+        }
+        if (c == '\'' || c == '"') return expr { expr::kind::literal, quoted() };
+        if (c == '.') {
+            ++pos;
+            return expr { expr::kind::byte };
+        }
+        if (c == '[') {
+            ++pos;
+            expr out { expr::kind::set };
+            while (pos < in.size() && in[pos] != ']') {
+                const auto low = static_cast<unsigned char>(escaped());
+                auto high = low;
+                if (pos + 1 < in.size() && in[pos] == '-' && in[pos + 1] != ']') {
+                    ++pos;
+                    high = static_cast<unsigned char>(escaped());
+                }
+                if (high < low) error("Empty range in a set");
+                for (unsigned b = low; b <= high; ++b) out.members[b] = true;
+            }
+            if (pos >= in.size()) error("Unterminated set");
+            ++pos;
+            return out;
+        }
+        if (c == '@') {
+            ++pos;
+            return expr { expr::kind::external, qualified() };
+        }
+
+        const auto name = identifier();
+        if (name == "until" || name == "repeatedly") {
+            if (!take("(")) error("Expected '(' after " + name);
+            expr out { name == "until" ? expr::kind::until : expr::kind::repeatedly };
+            out.children.push_back(choice());
+            if (out.type == expr::kind::until || take(",")) {
+                if (out.type == expr::kind::until && !take(",")) error("until takes a stop and what comes before it");
+                out.children.push_back(choice());
+            }
+            if (!take(")")) error("Expected ')'");
+            return out;
+        }
+        return expr { expr::kind::rule, name };
+    }
+
+    std::string file;
+    std::string in;
+    std::size_t pos = 0;
+};
+
+// The bytes a match of an expression can start with, and whether it can
+// match without consuming anything (then any byte will do). Rules the
+// analysis is already inside of, and @functions, could be anything.
+struct first_set {
+    std::array<bool, 256> bytes {};
+    bool empty = false;
+
+    void add(const first_set& other) {
+        for (std::size_t b = 0; b < 256; ++b) bytes[b] = bytes[b] || other.bytes[b];
+    }
+
+    bool may_start(const unsigned char b) const { return empty || bytes[b]; }
+};
+
+class generator {
+public:
+    explicit generator(const grammar& g) : g(g) {}
+
+    std::string run(const std::string& source) {
+        for (const auto& [name, body] : g.rules) check(body, name);
+        for (std::size_t i = 0; i < g.rules.size(); ++i) {
+            std::vector<std::size_t> path;
+            left_recursion(i, path);
+        }
+
+        std::ostringstream body;
+        for (const auto& [name, e] : g.rules) {
+            const auto id = emit(e);
+            body << "std::size_t r_" << name << "(context& c, const std::size_t at) { return e" << id << "(c, at); }\n\n";
+        }
+
+        std::ostringstream out;
+        out << "// Generated by parsec_pegc from " << source << ", do not edit\n"
+            << "#pragma once\n\n"
+            << "#include <cstddef>\n#include <optional>\n#include <string>\n#include <string_view>\n\n"
+            << "#include \"parsec.hpp\"\n";
+        for (const auto& include : g.includes) out << "#include \"" << include << "\"\n";
+        out << "\nnamespace " << g.name_space << " {\nnamespace detail {\n\n"
+            << "constexpr std::size_t no = std::size_t(-1);\n\n"
+            << "// The input, and the furthest offset a terminal failed at\n"
+            << "struct context {\n"
+            << "    std::string_view in;\n"
+            << "    std::size_t furthest = no;\n\n"
+            << "    void fail(const std::size_t at) {\n"
+            << "        if (furthest == no || at > furthest) furthest = at;\n"
+            << "    }\n"
+            << "};\n\n";
+        for (const auto& [name, e] : g.rules) out << "std::size_t r_" << name << "(context& c, std::size_t at);\n";
+        out << "\n" << functions.str() << body.str()
+            << "parsec::Match run(std::size_t (*rule)(context&, std::size_t), const std::string_view in) {\n"
+            << "    context c { in };\n"
+            << "    const auto end = rule(c, 0);\n"
+            << "    if (c.furthest != no) parsec::failedAt(in.substr(c.furthest));\n"
+            << "    if (end == no) return std::nullopt;\n"
+            << "    return end;\n"
+            << "}\n\n"
+            << "} // namespace detail\n\n";
+
+        for (const auto& [name, e] : g.rules) {
+            out << "parsec::Parser " << name << "() {\n"
+                << "    return parsec::Node { parsec::Node::Kind::fn, [](const std::string_view in) -> parsec::Result {\n"
+                << "        const auto n = detail::run(detail::r_" << name << ", in);\n"
+                << "        if (!n) return parsec::Failure { \"" << name << ": No match\" };\n"
+                << "        return parsec::Success { std::string(in.substr(0, *n)), in.substr(*n) };\n"
+                << "    }, {}, {}, [](const std::string_view in) { return detail::run(detail::r_" << name << ", in); } };\n"
+                << "}\n\n";
+        }
+        out << "} // namespace " << g.name_space << "\n";
+        return out.str();
+    }
+
+private:
+    void check(const expr& e, const std::string& rule) {
+        if (e.type == expr::kind::rule && !g.index.count(e.text)) fail(rule, "Refers to " + e.text + ", which isn't defined");
+        for (const auto& child : e.children) check(child, rule);
+    }
+
+    // The rules `e` can call at the offset it starts at
+    void leading(const expr& e, std::set<std::size_t>& out) {
+        switch (e.type) {
+            case expr::kind::rule:
+                out.insert(g.index.at(e.text));
+                return;
+            case expr::kind::sequence:
+                for (const auto& child : e.children) {
+                    leading(child, out);
+                    if (!first(child).empty) return;
+                }
+                return;
+            case expr::kind::implies: case expr::kind::repeatedly:
+                leading(e.children[0], out);
+                if (e.children.size() > 1 && first(e.children[0]).empty) leading(e.children[1], out);
+                return;
+            default:
+                for (const auto& child : e.children) leading(child, out);
+                return;
+        }
+    }
+
+    // A rule that can get back to itself without consuming anything would
+    // recurse until the stack runs out
+    void left_recursion(const std::size_t rule, std::vector<std::size_t>& path) {
+        if (checked.count(rule)) return;
+        for (std::size_t i = 0; i < path.size(); ++i) {
+            if (path[i] != rule) continue;
+            std::string cycle;
+            for (; i < path.size(); ++i) cycle += g.rules[path[i]].first + " -> ";
+            fail(g.rules[rule].first, "Left recursive: " + cycle + g.rules[rule].first);
+        }
+
+        path.push_back(rule);
+        std::set<std::size_t> next;
+        leading(g.rules[rule].second, next);
+        for (const auto r : next) left_recursion(r, path);
+        path.pop_back();
+        checked.insert(rule);
+    }
+
+    first_set first(const expr& e) {
+        first_set out;
+        switch (e.type) {
+            case expr::kind::literal:
+                if (e.text.empty()) {
+                    out.empty = true;
+                } else {
+                    out.bytes[static_cast<unsigned char>(e.text[0])] = true;
+                }
+                return out;
+            case expr::kind::set:
+                out.bytes = e.members;
+                return out;
+            case expr::kind::byte:
+                out.bytes.fill(true);
+                return out;
+            case expr::kind::external:
+                out.bytes.fill(true);
+                out.empty = true;
+                return out;
+            case expr::kind::rule: {
+                const auto r = g.index.at(e.text);
+                if (const auto found = firsts.find(r); found != firsts.end()) return found->second;
+                if (!analysing.insert(r).second) {
+                    out.bytes.fill(true);
+                    out.empty = true;
+                    return out;
+                }
+                out = first(g.rules[r].second);
+                analysing.erase(r);
+                if (analysing.empty()) firsts[r] = out;
+                return out;
+            }
+            case expr::kind::sequence:
+                out.empty = true;
+                for (const auto& child : e.children) {
+                    const auto f = first(child);
+                    out.add(f);
+                    if (!f.empty) {
+                        out.empty = false;
+                        break;
+                    }
+                }
+                return out;
+            case expr::kind::choice:
+                for (const auto& child : e.children) {
+                    const auto f = first(child);
+                    out.add(f);
+                    out.empty = out.empty || f.empty;
+                }
+                return out;
+            case expr::kind::some:
+                return first(e.children[0]);
+            case expr::kind::any: case expr::kind::optional:
+                out = first(e.children[0]);
+                out.empty = true;
+                return out;
+            case expr::kind::implies:
+                // Nothing at all when the first part doesn't match
+                out = first(e.children[0]);
+                out.add(first(e.children[1]));
+                out.empty = true;
+                return out;
+            case expr::kind::until: {
+                const auto stop = first(e.children[0]);
+                const auto then = first(e.children[1]);
+                out = stop;
+                out.add(then);
+                out.empty = stop.empty || then.empty;
+                return out;
+            }
+            case expr::kind::repeatedly: {
+                // Fails unless it consumes something
+                out = first(e.children[0]);
+                if (out.empty && e.children.size() > 1) out.add(first(e.children[1]));
+                out.empty = false;
+                return out;
+            }
+        }
+        return out;
+    }
+
+    static std::string literal(const std::string& bytes) {
+        std::string out = "\"";
+        for (const char c : bytes) {
+            const auto b = static_cast<unsigned char>(c);
+            if (std::isalnum(b) || b == ' ' || b == '_') {
+                out += c;
+            } else {
+                char octal[8];
+                std::snprintf(octal, sizeof(octal), "\\%03o", b);
+                out += octal;
+            }
+        }
+        return out + "\"";
+    }
+
+    // Writes out a function for `e` (and its parts), returning its number.
+    // Each takes the offset to start at and returns where the match ends,
+    // or `no`.
+    std::size_t emit(const expr& e) {
+        std::vector<std::size_t> parts;
+        for (const auto& child : e.children) parts.push_back(emit(child));
+        const auto id = next_id++;
+
+        std::ostringstream f;
+        f << "std::size_t e" << id << "(context& c, std::size_t at) {\n";
+        const auto call = [&parts](const std::size_t i, const std::string& at = "at") {
+            return "e" + std::to_string(parts[i]) + "(c, " + at + ")";
+        };
+
+        switch (e.type) {
+            case expr::kind::literal:
+                if (e.text.size() == 1) {
+                    f << "    if (at < c.in.size() && static_cast<unsigned char>(c.in[at]) == " << unsigned(static_cast<unsigned char>(e.text[0])) << ") return at + 1;\n";
+                } else {
+                    f << "    if (c.in.substr(at, " << e.text.size() << ") == std::string_view(" << literal(e.text) << ", " << e.text.size() << ")) return at + " << e.text.size() << ";\n";
+                }
+                f << "    c.fail(at);\n    return no;\n";
+                break;
+            case expr::kind::set: {
+                std::ostringstream labels;
+                if (cases(labels, [&e](const unsigned char b) { return e.members[b]; }, "            ")) {
+                    f << "    if (at < c.in.size()) {\n"
+                      << "        switch (static_cast<unsigned char>(c.in[at])) {\n"
+                      << labels.str() << " return at + 1;\n"
+                      << "            default: break;\n"
+                      << "        }\n"
+                      << "    }\n";
+                }
+                f << "    c.fail(at);\n    return no;\n";
+                break;
+            }
+            case expr::kind::byte:
+                f << "    if (at < c.in.size()) return at + 1;\n    c.fail(at);\n    return no;\n";
+                break;
+            case expr::kind::external:
+                f << "    const std::size_t n = " << e.text << "(c.in.substr(at));\n"
+                  << "    return n ? at + n : no;\n";
+                break;
+            case expr::kind::rule:
+                f << "    return r_" << e.text << "(c, at);\n";
+                break;
+            case expr::kind::sequence:
+                for (std::size_t i = 0; i < parts.size(); ++i) {
+                    f << "    at = " << call(i) << ";\n    if (at == no) return no;\n";
+                }
+                f << "    return at;\n";
+                break;
+            case expr::kind::choice:
+                choice(f, e, parts);
+                break;
+            case expr::kind::some:
+                f << "    const auto start = at;\n"
+                  << "    for (std::size_t end; (end = " << call(0) << ") != no; ) at = end;\n"
+                  << "    return at == start ? no : at;\n";
+                break;
+            case expr::kind::any:
+                f << "    if (at == c.in.size()) return at;\n"
+                  << "    for (std::size_t end; (end = " << call(0) << ") != no && end != at; ) at = end;\n"
+                  << "    return at;\n";
+                break;
+            case expr::kind::optional:
+                f << "    const auto end = " << call(0) << ";\n"
+                  << "    return end == no ? at : end;\n";
+                break;
+            case expr::kind::implies:
+                f << "    const auto end = " << call(0) << ";\n"
+                  << "    if (end == no) return at;\n"
+                  << "    return " << call(1, "end") << ";\n";
+                break;
+            case expr::kind::until:
+                f << "    while (true) {\n"
+                  << "        if (at == c.in.size()) {\n"
+                  << "            c.fail(at);\n"
+                  << "            return no;\n"
+                  << "        }\n"
+                  << "        if (const auto end = " << call(0) << "; end != no) return end;\n"
+                  << "        at = " << call(1) << ";\n"
+                  << "        if (at == no) return no;\n"
+                  << "    }\n";
+                break;
+            case expr::kind::repeatedly:
+                // As match::repeatedly: a separator has to be followed by
+                // another item, and nothing at all is a failure
+                f << "    const auto start = at;\n"
+                  << "    std::size_t matched = at;\n"
+                  << "    while (at != c.in.size()) {\n"
+                  << "        const auto item = " << call(0) << ";\n"
+                  << "        if (item == no) break;\n"
+                  << "        at = matched = item;\n";
+                if (parts.size() > 1) {
+                    f << "        const auto separator = " << call(1) << ";\n"
+                      << "        if (separator == no) break;\n"
+                      << "        at = separator;\n";
+                }
+                f << "    }\n"
+                  << "    if (matched == start || at != matched) return no;\n"
+                  << "    return at;\n";
+                break;
+        }
+        f << "}\n\n";
+
+        functions << f.str();
+        return id;
+    }
+
+    // `case` labels for every byte `in` is true for, or nothing if none
+    template <typename F>
+    static bool cases(std::ostream& f, F in, const std::string& indent) {
+        bool any = false;
+        int on_line = 0;
+        for (unsigned b = 0; b < 256; ++b) {
+            if (!in(static_cast<unsigned char>(b))) continue;
+            if (on_line == 0) f << (any ? "\n" : "") << indent;
+            f << (on_line ? " " : "") << "case " << b << ":";
+            any = true;
+            on_line = (on_line + 1) % 12;
+        }
+        return any;
+    }
+
+    // A choice tries its alternatives in order. Where the next byte rules
+    // some of them out, a switch on it goes straight to the ones that are
+    // left; the ones skipped would have failed right at `at`, which is
+    // noted in their place so the furthest failure comes out the same.
+    void choice(std::ostream& f, const expr& e, const std::vector<std::size_t>& parts) {
+        std::vector<first_set> firsts;
+        for (const auto& child : e.children) firsts.push_back(first(child));
+
+        const auto all = [&parts](std::ostream& f, const std::string& indent) {
+            for (const auto p : parts) {
+                f << indent << "if (const auto end = e" << p << "(c, at); end != no) return end;\n";
+            }
+            f << indent << "return no;\n";
+        };
+
+        // Which alternatives each byte leaves, as a bit mask per byte
+        std::map<std::vector<bool>, std::vector<unsigned char>> groups;
+        for (unsigned b = 0; b < 256; ++b) {
+            std::vector<bool> left;
+            for (const auto& first : firsts) left.push_back(first.may_start(static_cast<unsigned char>(b)));
+            groups[left].push_back(static_cast<unsigned char>(b));
+        }
+        if (groups.size() == 1 && groups.begin()->first == std::vector<bool>(parts.size(), true)) {
+            all(f, "    ");
+            return;
+        }
+
+        // At the end of the input every alternative gets its turn, some
+        // of them (repeatedly) give up there without noting anything
+        f << "    if (at == c.in.size()) {\n";
+        all(f, "        ");
+        f << "    }\n\n"
+          << "    switch (static_cast<unsigned char>(c.in[at])) {\n";
+        for (const auto& [left, bytes] : groups) {
+            const std::set<unsigned char> members(bytes.begin(), bytes.end());
+            cases(f, [&members](const unsigned char b) { return members.count(b) > 0; }, "        ");
+            f << " {\n";
+            bool noted = false;
+            for (std::size_t i = 0; i < parts.size(); ++i) {
+                if (left[i]) {
+                    f << "            if (const auto end = e" << parts[i] << "(c, at); end != no) return end;\n";
+                    noted = false;
+                } else if (!noted) {
+                    f << "            c.fail(at);\n";
+                    noted = true;
+                }
+            }
+            f << "            return no;\n        }\n";
+        }
+        f << "    }\n    return no;\n";
+    }
+
+    const grammar& g;
+    std::map<std::size_t, first_set> firsts;
+    std::set<std::size_t> analysing;
+    std::set<std::size_t> checked;
+    std::ostringstream functions;
+    std::size_t next_id = 0;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::fprintf(stderr, "usage: %s grammar.peg out.hpp\n", argv[0]);
+        return 2;
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) fail(argv[1], "Could not read it");
+    std::ostringstream text;
+    text << file.rdbuf();
+
+    const auto g = reader(argv[1], text.str()).run();
+    auto source = std::string(argv[1]);
+    source = source.substr(source.find_last_of('/') + 1);
+    const auto code = generator(g).run(source);
+
+    std::ofstream out(argv[2], std::ios::binary);
+    out << code;
+    if (!out) fail(argv[2], "Could not write it");
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <catch2/catch_test_macros.hpp>
+#include "../parsec.hpp"
+#include "../json/json.hpp"
+#include "../edits.hpp"
+#include "json.peg.hpp"
+#include "test.peg.hpp"
+
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace parsec;
+
+// What a parser does with `in`: what it matched, how much it recognizes, and
+// where it noted its furthest failure. Failure messages are left out, the
+// generated ones name the rule instead.
+std::tuple<std::optional<Success>, Match, long> outcome(const Parser& p, const std::string& in) {
+    const Tracked tracked;
+    furthest = nullptr;
+    const auto res = p(in);
+    const auto where = furthest ? furthest - in.data() : -1;
+
+    furthest = nullptr;
+    const auto length = p.recognize(in);
+    REQUIRE( (furthest ? furthest - in.data() : -1) == where );
+
+    std::optional<Success> success;
+    if (const auto* s = std::get_if<Success>(&res)) success = *s;
+    return { success, length, where };
+}
+
+SCENARIO("Generated JSON grammar") {
+    const auto reference = json::parser(false);
+    const auto generated = json_peg::value();
+
+    const std::vector<std::string> corpus {
+        "{\"a\": [1, -2.5e3, {}, []], \"b\" : {\"c\": \"d\\n\"}}",
+        "[ 0.5 , \"x\" ,[ ] , { \"k\" :\t-0 } ]",
+        "[1 2]",
+        "{\"a\":1e+7}",
+        "\"caf\xC3\xA9\"",
+    };
+
+    THEN("it agrees with json::parser() on every single-character edit of the corpus") {
+        edits::check(corpus, " ,:[]{}\"-.e1\\", [&](const std::string& edit) {
+            return outcome(generated, edit) == outcome(reference, edit);
+        });
+    }
+
+    THEN("every rule is there") {
+        REQUIRE( json_peg::number().recognize("-12.5e+3,") == 8 );
+        REQUIRE( json_peg::ws().recognize(" \t\nx") == 3 );
+        REQUIRE( std::holds_alternative<Failure>(json_peg::object()("[]")) );
+    }
+}
+
+SCENARIO("Generated rules behave as the combinators they stand for") {
+    using namespace parsec::match;
+    using namespace parsec::seq;
+    const auto anything = ch_fn([](const char) { return true; });
+    const auto abc = set("abc");
+    // Refers to itself through a plain pointer, like the rules in json.hpp
+    Parser nested;
+    nested = oneOf({ andThen({ ch('('), parsec::optional(Parser([rule = &nested](std::string_view in) { return (*rule)(in); })), ch(')') }), set("a*") });
+
+    const std::vector<std::pair<Parser, Parser>> rules {
+        { test_peg::comment(), andThen({ str("/*"), until(str("*/"), anything) }) },
+        { test_peg::list(), repeatedly(some(abc), str(", ")) },
+        { test_peg::items(), repeatedly(oneOf({ ch('x'), str("yz") })) },
+        { test_peg::keyword(), oneOf({ str("let"), str("letter"), some(ch_fn([](const char c) { return c >= 'a' && c <= 'z'; })) }) },
+        { test_peg::mixed(), oneOf({ andThen({ any(xImplies({ ch('a'), ch('b') })), parsec::optional(set("ab")), some(ch('c')) }), ch('*') }) },
+        { test_peg::nested(), nested },
+    };
+
+    THEN("on every short string over the characters they care about") {
+        const std::string alphabet = "abcxyz/*(), let";
+        for (const auto& [generated, combinators] : rules) {
+            for (std::size_t n = 0; n < 60000; ++n) {
+                std::string in;
+                for (auto k = n; k; k /= alphabet.size() + 1) {
+                    if (k % (alphabet.size() + 1)) in += alphabet[k % (alphabet.size() + 1) - 1];
+                }
+                REQUIRE( outcome(generated, in) == outcome(combinators, in) );
+            }
+        }
+    }
+}